@@ -0,0 +1,153 @@
+/**************************************************************************************************
+ *
+ * AnnealBatch.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Batch mode for annealing. With a Batch Size set in Annealer Settings, pressing Start begins a
+ * batch - we count cases as the inductor finishes with each one, and once the last one is out
+ * the trap door, we stop and wait for Start again. A Batch Size of 0 runs forever, same as it
+ * always has.
+ *
+ * While a batch is running, the State line turns into a throughput readout:
+ *
+ * 01234567890123456789
+ *  42/100  742/h  4.9s    <-- cases done/batch size, cases per hour, average cycle time
+ *
+ * Throughput is figured from when Start was pressed to when the latest case finished, so
+ * waiting on the operator to load cases counts against it - that's the number that matters
+ * when tuning Delay and Trapdoor. When a batch finishes (or gets stopped part way), one line
+ * goes to BATCH_LOG_FILE on the OpenLog, with the settings it ran with.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+#include "AnnealFormat.h"
+
+int batchSize = 0;                    // from the menu - 0 for no batch
+int batchTarget = 0;                  // batchSize, as of the Start press - 0 if no batch running
+int batchCount = 0;
+unsigned long batchStartMillis = 0;
+unsigned long batchLastMillis = 0;    // when the latest case finished
+
+
+// milliseconds the batch has run, up to its latest case
+static unsigned long batchElapsed(void) {
+  return batchCount ? (batchLastMillis - batchStartMillis) : 0;
+}
+
+static unsigned long batchCasesPerHour(void) {
+  unsigned long elapsed = batchElapsed();
+  return elapsed ? (((unsigned long) batchCount * 3600000UL) + (elapsed / 2)) / elapsed : 0;
+}
+
+// average cycle, in tenths of a second
+static unsigned long batchCycleTenths(void) {
+  return batchCount ? (batchElapsed() + (batchCount * 50UL)) / (batchCount * 100UL) : 0;
+}
+
+
+/*
+ * batchStart
+ *
+ * Called when Start is pressed - begin counting, if there's a batch size set
+ */
+void batchStart(void) {
+  batchTarget = batchSize;
+  batchCount = 0;
+  batchStartMillis = halMillis();
+  batchLastMillis = batchStartMillis;
+}
+
+/*
+ * batchCaseDone
+ *
+ * Count a case - called as the inductor switches off
+ */
+void batchCaseDone(void) {
+  if (!batchTarget) return;
+
+  batchCount++;
+  batchLastMillis = halMillis();
+}
+
+/*
+ * batchComplete
+ *
+ * True once a running batch has all its cases
+ */
+boolean batchComplete(void) {
+  return batchTarget && (batchCount >= batchTarget);
+}
+
+/*
+ * batchEnd
+ *
+ * The batch is over, finished or not - log it, if we got anywhere. The numbers stay on the
+ * screen until the next Start, or we leave annealing mode (batchClear).
+ */
+void batchEnd(void) {
+  if (!batchTarget || !batchCount) return;
+
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: BATCH: ")); Serial.print(batchCount);
+  Serial.print(F(" cases, ")); Serial.print(batchCasesPerHour());
+  Serial.println(F(" per hour"));
+  #endif
+
+  if (mayanUseSD) {
+    char line[LOG_LINE_LENGTH + 16];
+    char *p;
+
+    p = formatUnsigned(line, batchTarget);
+    *p++ = ',';
+    p = formatUnsigned(p, batchCount);
+    *p++ = ',';
+    p = formatUnsigned(p, (batchElapsed() + 500) / 1000);
+    *p++ = ',';
+    p = formatUnsigned(p, batchCasesPerHour());
+    *p++ = ',';
+    p = formatScaled<4,1>(p, batchCycleTenths()) + 4;
+    *p++ = ',';
+    p = formatFixed<5,2>(p, annealSetPoint) + 5;
+    *p++ = ',';
+    p = formatFixed<5,2>(p, delaySetPoint) + 5;
+    *p++ = ',';
+    formatFixed<5,2>(p, caseDropSetPoint);
+    annealLogBatch(line);
+  }
+}
+
+/*
+ * batchClear
+ *
+ * Drop the batch numbers - the State line goes back to showing the state
+ */
+void batchClear(void) {
+  batchTarget = 0;
+  batchCount = 0;
+}
+
+/*
+ * batchFormatStatus
+ *
+ * The throughput readout, exactly LCD_COLS wide - buf needs LCD_COLS + 1 chars
+ */
+char *batchFormatStatus(char *buf) {
+  char *p = buf;
+
+  p = formatScaled<3,0>(p, batchCount) + 3;
+  *p++ = '/';
+  p = formatScaled<3,0>(p, batchTarget) + 3;
+  *p++ = ' ';
+  p = formatScaled<4,0>(p, batchCasesPerHour()) + 4;
+  *p++ = '/';
+  *p++ = 'h';
+  *p++ = ' ';
+  p = formatScaled<4,1>(p, batchCycleTenths()) + 4;
+  *p++ = 's';
+  *p = '\0';
+
+  return buf;
+}
@@ -16,6 +16,10 @@
 int storedSetPoint = 0;       // the annealSetPoint value hanging out in EEPROM - need this for comparison later
 int storedDelaySetPoint = 0;
 int storedCaseDropSetPoint = 0;
+int storedBatchSize = 0;
+boolean storedDelayGovernor = false;
+float storedDelayCeiling = DELAY_CEILING_DEFAULT;
+float storedAnnealEnergy = 0.0;
 
 const char* caseNameDefault = "unused      ";
 
@@ -23,6 +27,13 @@ StoredCase storedCases[10];
 
 boolean eepromGood = false;
 
+
+// energy set points are newer than the failsafe value too - anything that isn't a sensible
+// number of joules (including blank EEPROM, which reads as NaN) means time only
+static float eepromValidEnergy(float joules) {
+  return ((joules >= 0.0) && (joules <= ANNEAL_ENERGY_MAX)) ? joules : 0.0;
+}
+
 void eepromStartup(void) {
   
   // double check that we can trust the EEPROM by looking for a previously
@@ -45,6 +56,9 @@ void eepromStartup(void) {
     EEPROM.get(CASEDROP_ADDR, storedCaseDropSetPoint);
     EEPROM.get(START_ON_OPTO_ADDR, startOnOpto);
     EEPROM.get(MAYAN_USE_SD_ADDR, mayanUseSD);
+    EEPROM.get(BATCH_SIZE_ADDR, storedBatchSize);
+    EEPROM.get(DELAY_CEILING_ADDR, storedDelayCeiling);
+    EEPROM.get(ANNEAL_ENERGY_ADDR, storedAnnealEnergy);
 
     eepromGood = true;
 
@@ -64,6 +78,11 @@ void eepromStartup(void) {
     EEPROM.put(CASEDROP_ADDR, storedCaseDropSetPoint);
     EEPROM.put(START_ON_OPTO_ADDR, startOnOpto);
     EEPROM.put(MAYAN_USE_SD_ADDR, mayanUseSD);
+    storedBatchSize = 0;
+    EEPROM.put(BATCH_SIZE_ADDR, storedBatchSize);
+    EEPROM.put(DELAY_GOVERNOR_ADDR, (uint8_t) storedDelayGovernor);
+    EEPROM.put(DELAY_CEILING_ADDR, storedDelayCeiling);
+    EEPROM.put(ANNEAL_ENERGY_ADDR, storedAnnealEnergy);
 
     eepromGood = false;
   }
@@ -96,6 +115,34 @@ void eepromStartup(void) {
   else {
     caseDropSetPoint = storedCaseDropSetPoint / 100.0;
   }
+
+  // batch size is newer than the failsafe value, so it may never have been written - 0 is a 
+  // legit setting here (no batch), so check the range instead
+  if ((storedBatchSize < 0) || (storedBatchSize > BATCH_SIZE_MAX)) {
+    storedBatchSize = 0;
+    EEPROM.put(BATCH_SIZE_ADDR, storedBatchSize);
+  }
+  batchSize = storedBatchSize;
+
+  // same story for the delay governor - an unwritten byte reads 0xFF, so anything but 0 or 1 
+  // means off, and a ceiling out of range (or not a number at all) goes back to the default
+  uint8_t governorByte;
+  EEPROM.get(DELAY_GOVERNOR_ADDR, governorByte);
+  if (governorByte > 1) {
+    governorByte = 0;
+    EEPROM.put(DELAY_GOVERNOR_ADDR, governorByte);
+  }
+  storedDelayGovernor = governorByte;
+  delayGovernor = storedDelayGovernor;
+
+  if (!(storedDelayCeiling >= DELAY_CEILING_MIN) || (storedDelayCeiling > DELAY_CEILING_MAX)) {
+    storedDelayCeiling = DELAY_CEILING_DEFAULT;
+    EEPROM.put(DELAY_CEILING_ADDR, storedDelayCeiling);
+  }
+  delayCeiling = storedDelayCeiling;
+
+  storedAnnealEnergy = eepromValidEnergy(storedAnnealEnergy);
+  annealEnergySetPoint = storedAnnealEnergy;
   
 
   #ifdef DEBUG
@@ -112,10 +159,16 @@ void eepromStartup(void) {
     if (eepromGood) {
       EEPROM.get((CASE_NAME_ARRAY_START_ADDR + (i*15)), storedCases[i].name);
       EEPROM.get((CASE_STORED_ARRAY_START_ADDR + (i * sizeof(float))), storedCases[i].time);
+      EEPROM.get((CASE_ENERGY_ARRAY_START_ADDR + (i * sizeof(float))), storedCases[i].energy);
+      if (storedCases[i].energy != eepromValidEnergy(storedCases[i].energy)) {
+        storedCases[i].energy = 0.0;
+        EEPROM.put((CASE_ENERGY_ARRAY_START_ADDR + (i * sizeof(float))), storedCases[i].energy);
+      }
     }
     else {
       EEPROM.put((CASE_NAME_ARRAY_START_ADDR + (i*15)), storedCases[i].name);
       EEPROM.put((CASE_STORED_ARRAY_START_ADDR + (i * sizeof(float))), storedCases[i].time);
+      EEPROM.put((CASE_ENERGY_ARRAY_START_ADDR + (i * sizeof(float))), storedCases[i].energy);
     }
   }
   
@@ -169,9 +222,53 @@ void eepromCheckCaseDropSetPoint (void) {
   }
 }
 
+void eepromCheckBatchSize(void) {
+  #ifdef DEBUG
+    Serial.println(F("DEBUG: EEPROM checking batchSize"));
+  #endif
+  if (storedBatchSize != batchSize) {
+    storedBatchSize = batchSize;
+    #ifdef DEBUG
+      Serial.print(F("DEBUG: storedBatchSize != batchSize. Setting to: ")); Serial.println(storedBatchSize);
+    #endif
+    EEPROM.put(BATCH_SIZE_ADDR, storedBatchSize);
+  }
+}
+
+void eepromCheckDelayGovernor(void) {
+  #ifdef DEBUG
+    Serial.println(F("DEBUG: EEPROM checking delay governor"));
+  #endif
+  if (storedDelayGovernor != delayGovernor) {
+    storedDelayGovernor = delayGovernor;
+    EEPROM.put(DELAY_GOVERNOR_ADDR, (uint8_t) storedDelayGovernor);
+  }
+  if (storedDelayCeiling != delayCeiling) {
+    storedDelayCeiling = delayCeiling;
+    #ifdef DEBUG
+      Serial.print(F("DEBUG: storedDelayCeiling != delayCeiling. Setting to: ")); Serial.println(storedDelayCeiling);
+    #endif
+    EEPROM.put(DELAY_CEILING_ADDR, storedDelayCeiling);
+  }
+}
+
+void eepromCheckAnnealEnergy(void) {
+  #ifdef DEBUG
+    Serial.println(F("DEBUG: EEPROM checking annealEnergySetPoint"));
+  #endif
+  if (storedAnnealEnergy != annealEnergySetPoint) {
+    storedAnnealEnergy = annealEnergySetPoint;
+    #ifdef DEBUG
+      Serial.print(F("DEBUG: storedAnnealEnergy != annealEnergySetPoint. Setting to: ")); Serial.println(storedAnnealEnergy);
+    #endif
+    EEPROM.put(ANNEAL_ENERGY_ADDR, storedAnnealEnergy);
+  }
+}
+
 void eepromStoreCase(int index) {
   EEPROM.put((CASE_NAME_ARRAY_START_ADDR + (index*15)), storedCases[index].name);
   EEPROM.put((CASE_STORED_ARRAY_START_ADDR + (index * sizeof(float))), storedCases[index].time);
+  EEPROM.put((CASE_ENERGY_ARRAY_START_ADDR + (index * sizeof(float))), storedCases[index].energy);
 }
 
 void eepromStoreStartOnOpto() {
@@ -181,3 +278,25 @@ void eepromStoreStartOnOpto() {
 void eepromStoreMayanUseSD() {
   EEPROM.put(MAYAN_USE_SD_ADDR, mayanUseSD);
 }
+
+/*
+ * eepromGetLogSequence
+ * 
+ * Returns the next log file number, or 0 if what's stored doesn't check out - a fresh or wiped 
+ * EEPROM, say. The number is stored next to its complement, so junk is easy to spot.
+ */
+uint16_t eepromGetLogSequence(void) {
+  uint16_t seq[2];
+  
+  EEPROM.get(LOG_SEQ_ADDR, seq);
+  if (seq[1] != (uint16_t) ~seq[0]) {
+    return 0;
+  }
+  return seq[0];
+}
+
+void eepromStoreLogSequence(uint16_t next) {
+  uint16_t seq[2] = { next, (uint16_t) ~next };
+  
+  EEPROM.put(LOG_SEQ_ADDR, seq);
+}
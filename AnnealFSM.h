@@ -0,0 +1,88 @@
+/**************************************************************************************************
+ *
+ * AnnealFSM.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Table driven state machine engine, shared by annealing and Mayan modes. Each mode lays out
+ * its states as a const table of FsmState, one entry per enum value, in enum order:
+ *
+ *   enter()   runs once, as the state is entered - the one-time setup that used to sit behind
+ *             a "first pass" flag, or at the bottom of whichever state led here
+ *   tick()    runs every pass while we're in the state, and returns the state to be in next -
+ *             its own, to stay put. Required
+ *   exit()    runs once, as we leave - however we leave, stop button included
+ *
+ * enter and exit can be NULL. They must not change state themselves - only tick() (through its
+ * return value) and go() do that.
+ *
+ *   StateMachine<AnnealState, ANNEAL_STATES> annealFsm(annealStates, annealState, annealChanged);
+ *
+ * The machine keeps the mode's own state variable up to date, so annealState and mayanState
+ * still say where we are for the LCD, lcdBudget(), and the loop profiler. The table size is a
+ * template parameter, so a table that's missing a state won't compile. The optional changed()
+ * hook runs after every transition - for what a mode does on any state change, like keeping
+ * the dwell histograms.
+ *
+ * With DEBUG_STATE on, every transition prints the name of the state we're entering.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_FSM_H
+#define _ANNEAL_FSM_H
+
+#include "Annealer-Control.h"
+
+// state names only take up space when something's going to print them
+#ifdef DEBUG_STATE
+  #define FSM_NAME(name)    name
+#else
+  #define FSM_NAME(name)    NULL
+#endif
+
+struct FsmState {
+  const char *name;           // FSM_NAME("...")
+  void (*enter)(void);
+  uint8_t (*tick)(void);
+  void (*exit)(void);
+};
+
+
+template <typename S, uint8_t N>
+class StateMachine {
+  const FsmState *table;
+  S &state;
+  void (*changed)(void);
+
+public:
+  StateMachine(const FsmState (&states)[N], S &current, void (*onChange)(void) = NULL)
+    : table(states), state(current), changed(onChange) {}
+
+  /*
+   * go
+   *
+   * Leave the current state for next, whatever tick() thinks - for the stop button
+   */
+  void go(S next) {
+    if (table[state].exit) table[state].exit();
+
+    state = next;
+
+    #ifdef DEBUG_STATE
+    Serial.print(F("DEBUG: STATE MACHINE: enter ")); Serial.println(table[state].name);
+    #endif
+
+    if (table[state].enter) table[state].enter();
+    if (changed) changed();
+  }
+
+  // one pass - tick the current state, and move on if it says to
+  void run(void) {
+    uint8_t next = table[state].tick();
+
+    if (next != (uint8_t) state) go((S) next);
+  }
+};
+
+#endif // _ANNEAL_FSM_H
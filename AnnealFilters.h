@@ -0,0 +1,189 @@
+/**************************************************************************************************
+ *
+ * AnnealFilters.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Integer smoothing filters for the sensor channels. They run on raw ADC counts (the sums that
+ * come out of the background sampler), with all their parameters fixed at compile time, so an
+ * update is a handful of integer adds, multiplies, and shifts - no floating point, which the
+ * AVR boards have to do in software. Conversion to amps, volts, or degrees waits until somebody
+ * actually wants the number.
+ *
+ * Every filter has the same three calls:
+ *
+ *   reset(x)   start over, as if x had been coming in forever
+ *   add(x)     feed it the next input
+ *   value()    current output, in input units with FILTER_FRAC_BITS of fraction
+ *
+ * EmaFilter<NUM, SHIFT>      exponential moving average, weight NUM / 2^SHIFT on the newest
+ *                            input - EmaFilter<1,1> is the old 0.5 smoothing ratio, and
+ *                            EmaFilter<1,0> doesn't smooth at all
+ * MovingAverage<N>           plain average of the last N inputs
+ * BiquadLowPass<NB0..DA2>    second order IIR, coefficients in Q14 (16384 = 1.0) - the Butter*
+ *                            typedefs below are worked out ahead of time
+ *
+ * SlopeWindow<N> isn't a smoother, but it lives here too - a sliding least squares slope, for
+ * spotting when a reading turns over.
+ *
+ * Which filter each channel uses, in each mode, is picked in Annealer-Control.h.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_FILTERS_H
+#define _ANNEAL_FILTERS_H
+
+#include <Arduino.h>
+
+#define FILTER_FRAC_BITS    8
+
+
+template <uint8_t NUM, uint8_t SHIFT>
+class EmaFilter {
+  static_assert((NUM > 0) && (NUM <= (1 << SHIFT)), "EMA weight must be between 0 and 1");
+
+  int32_t state = 0;
+
+public:
+  void reset(uint32_t x) { state = (int32_t) x << FILTER_FRAC_BITS; }
+
+  // scaled down before the multiply, so a full scale 14 bit sum can't overflow
+  void add(uint32_t x) { state += ((((int32_t) x << FILTER_FRAC_BITS) - state) >> SHIFT) * NUM; }
+
+  int32_t value(void) const { return state; }
+};
+
+
+template <uint8_t N>
+class MovingAverage {
+  static_assert(N > 0, "MovingAverage needs at least one input");
+
+  uint32_t history[N];
+  uint32_t sum = 0;
+  uint8_t next = 0;
+
+public:
+  MovingAverage() { reset(0); }
+
+  void reset(uint32_t x) {
+    for (uint8_t i = 0; i < N; i++) history[i] = x;
+    sum = x * N;
+    next = 0;
+  }
+
+  void add(uint32_t x) {
+    sum += x - history[next];
+    history[next] = x;
+    next = (next + 1 < N) ? next + 1 : 0;
+  }
+
+  int32_t value(void) const { return ((uint64_t) sum << FILTER_FRAC_BITS) / N; }
+};
+
+
+/*
+ * BiquadLowPass
+ *
+ * Direct form I - NB* are the numerator (input) coefficients, DA* the denominator (feedback)
+ * ones, named so they can't collide with the A1/A2 pin macros. They have to add up to unity
+ * gain at DC - (NB0 + NB1 + NB2) == (16384 + DA1 + DA2) - or a steady input drifts. The
+ * accumulator is 64 bits, so this is the expensive one on an AVR - still cheaper than the float
+ * version would be.
+ */
+template <int16_t NB0, int16_t NB1, int16_t NB2, int16_t DA1, int16_t DA2>
+class BiquadLowPass {
+  static_assert((NB0 + NB1 + NB2) == (16384 + DA1 + DA2), "biquad coefficients need unity DC gain");
+
+  int32_t x1 = 0, x2 = 0;   // inputs, with FILTER_FRAC_BITS
+  int32_t y1 = 0, y2 = 0;   // outputs, likewise
+
+public:
+  void reset(uint32_t x) { x1 = x2 = y1 = y2 = (int32_t) x << FILTER_FRAC_BITS; }
+
+  void add(uint32_t x) {
+    int32_t x0 = (int32_t) x << FILTER_FRAC_BITS;
+    int64_t acc = ((int64_t) NB0 * x0) + ((int64_t) NB1 * x1) + ((int64_t) NB2 * x2)
+                - ((int64_t) DA1 * y1) - ((int64_t) DA2 * y2);
+
+    x2 = x1;
+    x1 = x0;
+    y2 = y1;
+    y1 = (int32_t) ((acc + 8192) >> 14);    // rounded - a plain shift settles a step 2/256 short
+  }
+
+  int32_t value(void) const { return y1; }
+};
+
+// Butterworth low pass, cutoff at a tenth of the sample rate - 2Hz at the sampler's 20Hz
+typedef BiquadLowPass<1105, 2210, 1105, -18727, 6763> ButterLowPassTenth;
+
+
+
+/*
+ * SlopeWindow
+ *
+ * Least squares slope of the last N inputs, taken one sample period apart - updated in constant
+ * time per input, no matter how big N is. We keep the plain sum S and the index weighted sum T
+ * (oldest input is index 0), and when the window slides, every index drops by one:
+ *
+ *   T' = T - (S - oldest) + (N - 1) * newest        S' = S - oldest + newest
+ *
+ * The slope is then (N*T - sum(i) * S) / (N * sum(i^2) - sum(i)^2), and since the denominator
+ * is a constant, slopeBelow() compares against it without ever dividing.
+ */
+template <uint8_t N>
+class SlopeWindow {
+  static_assert(N >= 2, "SlopeWindow needs at least two points for a slope");
+
+  static const int32_t SUM_I = ((int32_t) N * (N - 1)) / 2;
+  static const int32_t DENOMINATOR = ((int32_t) N * N * ((int32_t) N * N - 1)) / 12;
+
+  int32_t history[N];
+  int32_t sum = 0;
+  int32_t weighted = 0;
+  uint8_t next = 0;     // also the oldest, once we're full
+  uint8_t count = 0;
+
+public:
+  void reset(void) {
+    sum = 0;
+    weighted = 0;
+    next = 0;
+    count = 0;
+  }
+
+  void add(int32_t y) {
+    if (count < N) {
+      weighted += (int32_t) count * y;
+      sum += y;
+      count++;
+    }
+    else {
+      int32_t oldest = history[next];
+      weighted += ((int32_t) (N - 1) * y) - (sum - oldest);
+      sum += y - oldest;
+    }
+    history[next] = y;
+    next = (next + 1 < N) ? next + 1 : 0;
+  }
+
+  boolean full(void) const { return count == N; }
+
+  // slope times the denominator - in input units per sample
+  int32_t numerator(void) const { return ((int32_t) N * weighted) - (SUM_I * sum); }
+
+  /*
+   * slopeBelow
+   *
+   * True if the slope is less than rate input units per second, with inputs periodMs apart
+   */
+  boolean slopeBelow(int32_t rate, uint16_t periodMs) const {
+    return ((int64_t) numerator() * 1000) < ((int64_t) rate * DENOMINATOR * periodMs);
+  }
+  boolean slopeAbove(int32_t rate, uint16_t periodMs) const {
+    return ((int64_t) numerator() * 1000) > ((int64_t) rate * DENOMINATOR * periodMs);
+  }
+};
+
+#endif // _ANNEAL_FILTERS_H
@@ -0,0 +1,102 @@
+/**************************************************************************************************
+ *
+ * AnnealFormat.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Fixed width, fixed point number formatting for the LCD screens and the log - a replacement
+ * for building up Strings with concat() and dtostrf(), which churned the heap on every refresh.
+ *
+ * Everything writes into a buffer the caller owns. Field width and decimal places are template
+ * parameters, so the scaling constant is worked out at compile time, and the conversion is
+ * nothing but integer divides by 10.
+ *
+ *   char c[6];
+ *   formatFixed<5,2>(c, 9.876);     // " 9.88"
+ *   formatFixed<4,1>(c, 123.4);     // " 123" - too wide, so the decimals get dropped
+ *   formatScaled<5,2>(c, 1234);     // "12.34" - value is already in hundredths
+ *
+ * Output is right aligned and padded with spaces to exactly WIDTH characters, plus the null - so
+ * the buffer needs WIDTH+1 chars. If the number won't fit, we drop the decimals first, and if it
+ * still won't fit, the field is filled with '#'.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_FORMAT_H
+#define _ANNEAL_FORMAT_H
+
+#include <Arduino.h>
+
+template <uint8_t N> struct Pow10 { static const long value = 10L * Pow10<N - 1>::value; };
+template <> struct Pow10<0> { static const long value = 1L; };
+
+
+/*
+ * formatScaled
+ *
+ * value is already multiplied up by 10^DECIMALS - 1234 with 2 decimals is 12.34
+ */
+template <uint8_t WIDTH, uint8_t DECIMALS>
+char *formatScaled(char *buf, long value) {
+  boolean negative = (value < 0);
+  unsigned long v = negative ? -value : value;
+  int8_t pos = WIDTH;
+
+  buf[WIDTH] = '\0';
+
+  for (uint8_t i = 0; i < DECIMALS; i++) {
+    if (--pos < 0) break;
+    buf[pos] = '0' + (v % 10);
+    v /= 10;
+  }
+  if (DECIMALS && (--pos >= 0)) buf[pos] = '.';
+
+  do {                              // always at least one digit ahead of the decimal point
+    if (--pos < 0) break;
+    buf[pos] = '0' + (v % 10);
+    v /= 10;
+  } while (v);
+
+  if (negative && (--pos >= 0)) buf[pos] = '-';
+
+  if ((pos < 0) || v) {             // didn't fit
+    if (DECIMALS) {
+      long whole = ((negative ? -value : value) + (Pow10<DECIMALS>::value / 2)) / Pow10<DECIMALS>::value;
+      return formatScaled<WIDTH, 0>(buf, negative ? -whole : whole);
+    }
+    memset(buf, '#', WIDTH);
+    return buf;
+  }
+
+  while (pos > 0) buf[--pos] = ' ';
+  return buf;
+}
+
+template <uint8_t WIDTH, uint8_t DECIMALS>
+char *formatFixed(char *buf, float value) {
+  return formatScaled<WIDTH, DECIMALS>(buf, (long) ((value * Pow10<DECIMALS>::value) + ((value < 0) ? -0.5 : 0.5)));
+}
+
+
+/*
+ * formatUnsigned
+ *
+ * Left aligned, no padding - for building up log lines. Returns a pointer to the null at the
+ * end, so the next field can go right after it.
+ */
+inline char *formatUnsigned(char *buf, unsigned long value) {
+  char digits[10];
+  uint8_t n = 0;
+
+  do {
+    digits[n++] = '0' + (value % 10);
+    value /= 10;
+  } while (value);
+
+  while (n) *buf++ = digits[--n];
+  *buf = '\0';
+  return buf;
+}
+
+#endif // _ANNEAL_FORMAT_H
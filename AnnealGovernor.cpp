@@ -0,0 +1,114 @@
+/**************************************************************************************************
+ *
+ * AnnealGovernor.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Thermal delay governor. A fixed Delay has to be long enough for a coil that's already hot, so
+ * the early part of every batch waits on cooling it doesn't need. With the governor on, each
+ * cycle's DELAY comes from the coil temperature instead:
+ *
+ * - delaySetPoint is the pause when the coil is at delayCeiling
+ * - DELAY_GOVERNOR_BAND degrees below the ceiling and cooler, there's no pause at all, and in
+ *   between, it scales in a straight line
+ * - past the ceiling, it keeps stretching, up to DELAY_GOVERNOR_MAX_SCALE times delaySetPoint
+ *
+ * The temperature is whatever checkThermistors() and the sampler have already smoothed - the
+ * hotter of Therm1Temp and Therm2Temp, on boards with a second thermistor. We go by where it's
+ * headed, not just where it is: if it climbed since the last cycle, we assume the next case adds
+ * the same again.
+ *
+ * Each cycle's pick goes in DELAY_LOG_FILE on the OpenLog, so a run can be checked afterwards.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+#include "AnnealFormat.h"
+
+boolean delayGovernor = false;
+float delayCeiling = DELAY_CEILING_DEFAULT;
+
+uint16_t governorCycle = 0;
+float governorLastTemp = 0;
+boolean governorLogging = false;      // DELAY_LOG_FILE is open for this run
+
+
+// the temperature we govern on - the hottest one we have
+static float governorTemp(void) {
+  #ifdef THERM2_PIN
+  return (Therm2Temp > Therm1Temp) ? Therm2Temp : Therm1Temp;
+  #else
+  return Therm1Temp;
+  #endif
+}
+
+
+/*
+ * governorStart
+ *
+ * Called when Start is pressed - the first cycle has no trend to go on, and the log starts here
+ */
+void governorStart(void) {
+  boolean newFile;
+
+  governorCycle = 0;
+  governorLastTemp = governorTemp();
+  governorLogging = false;
+
+  if (delayGovernor && mayanUseSD && annealLogOpenText(DELAY_LOG_FILE, newFile)) {
+    if (newFile) {
+      annealLogWrite("cycle,temp,trend,delay");
+    }
+    annealLogWrite("#start");
+    governorLogging = true;
+  }
+}
+
+/*
+ * governorDelayMillis
+ *
+ * How long this cycle's DELAY should be - called once per cycle, as the trap door closes
+ */
+unsigned long governorDelayMillis(void) {
+  float base = delaySetPoint * 1000.0;
+  float temp, trend, scale;
+  unsigned long ms;
+
+  if (!delayGovernor) {
+    return (unsigned long) floor(base + 0.5);
+  }
+
+  temp = governorTemp();
+  trend = temp - governorLastTemp;
+  governorLastTemp = temp;
+
+  scale = ((temp + ((trend > 0) ? trend : 0)) - (delayCeiling - DELAY_GOVERNOR_BAND)) / DELAY_GOVERNOR_BAND;
+  if (scale < 0) scale = 0;
+  if (scale > DELAY_GOVERNOR_MAX_SCALE) scale = DELAY_GOVERNOR_MAX_SCALE;
+
+  ms = (unsigned long) floor((base * scale) + 0.5);
+  governorCycle++;
+
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: GOVERNOR: temp ")); Serial.print(temp);
+  Serial.print(F(" trend ")); Serial.print(trend);
+  Serial.print(F(" delay ")); Serial.println(ms);
+  #endif
+
+  if (governorLogging) {
+    char line[LOG_LINE_LENGTH];
+    char *p;
+
+    p = formatUnsigned(line, governorCycle);
+    *p++ = ',';
+    p = formatFixed<5,1>(p, temp) + 5;
+    *p++ = ',';
+    p = formatFixed<5,1>(p, trend) + 5;
+    *p++ = ',';
+    formatScaled<6,2>(p, (ms + 5) / 10);
+    annealLogWrite(line);
+  }
+
+  return ms;
+}
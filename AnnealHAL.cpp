@@ -0,0 +1,388 @@
+/**************************************************************************************************
+ *
+ * AnnealHAL.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Hardware abstraction layer. Every pin, ADC, and clock access made by the state machines, the
+ * sensor code, and setup()/loop() goes through the hal* functions in here, so the HAL is the only
+ * code that has to know how the controller talks to the board.
+ *
+ * That gives us one seam for swapping out the hardware. The few things that need registers - the
+ * inductor cutoff timer, the sampler's ticker, sleep, and pin change interrupts - are behind
+ * AnnealHALTarget.h, one small file per board. Everything in here is the same on every board,
+ * and the host (Linux) simulation builds it unchanged, with its own timer backend on a virtual
+ * clock, fake GPIO and ADC, and its own EEPROM, SerLCD, and OpenLog classes with the same
+ * interfaces as the libraries we use. The rest of the sketch compiles unchanged against either.
+ *
+ * Prototypes live in Annealer-Control.h with everything else.
+ *
+ **************************************************************************************************/
+
+#include "AnnealHALTarget.h"
+
+volatile boolean halInductorIsOn = false;
+volatile unsigned long halInductorStartMicros = 0;
+volatile unsigned long halInductorLastOnMicros = 0;
+
+/*
+ * Inductor cutoff timer
+ * 
+ * halInductorArm() switches the inductor on and sets up a one-shot hardware timer that switches
+ * it back off from an interrupt at the deadline, no matter what loop() happens to be doing at 
+ * the time (a slow I2C write to the LCD, say). The state machine just watches for
+ * halInductorExpired().
+ * 
+ * The timer itself is the board's - AnnealHALTarget.h. Here, we work out how many of its ticks
+ * the anneal takes, and feed them to it halCutoffChunkMax at a time. Boards with no timer get a
+ * micros() deadline that halInductorExpired() polls instead.
+ */
+volatile unsigned long halCutoffTicksLeft = 0;    // still to go after the compare that's set
+unsigned long halCutoffMicros = 0;                // polled on-time, 0 when nothing's armed
+
+boolean halTickerRunning = false;     // so it's safe to sleep - see halSleep()
+
+
+/*
+ * halBegin
+ *
+ * Pin modes and ADC setup - called once, first thing in setup(). Leaves the inductor board
+ * powered off and the trap door closed.
+ */
+void halBegin(void) {
+  pinMode(INDUCTOR_PIN, OUTPUT);
+  pinMode(SOLENOID_PIN, OUTPUT);
+  pinMode(START_PIN, INPUT_PULLUP);
+  pinMode(STOP_PIN, INPUT_PULLUP);
+  pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(OPTO1_PIN, INPUT_PULLUP);
+  #ifdef OPTO2_PIN
+  pinMode(OPTO2_PIN, INPUT_PULLUP);
+  #endif
+
+  halInductor(false);
+  halSolenoid(false);
+
+  #ifdef _AP3_VARIANT_H_
+    analogReadResolution(14); //Set ADC resolution to the highest value possible
+  #else
+    analogReadResolution(10);
+  #endif
+}
+
+
+/*
+ * halAttachInterrupt
+ *
+ * Hook an interrupt handler to a pin - used for the start and stop buttons
+ */
+void halAttachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  attachInterrupt(digitalPinToInterrupt(pin), handler, mode);
+}
+
+
+/*
+ * halInductorSwitch
+ *
+ * Drive the pins and timestamp the edges, as close to the pin as we can get, so
+ * halInductorOnTime() reports how long the board was really powered. The cutoff interrupt
+ * switches off through here, too.
+ */
+static void halInductorSwitch(boolean on) {
+  digitalWrite(INDUCTOR_PIN, on ? HIGH : LOW);
+  digitalWrite(LED_BUILTIN, on ? HIGH : LOW);
+
+  if (on && !halInductorIsOn) {
+    halInductorStartMicros = micros();
+  }
+  else if (!on && halInductorIsOn) {
+    halInductorLastOnMicros = micros() - halInductorStartMicros;
+  }
+  halInductorIsOn = on;
+}
+
+// stop the cutoff timer without letting it fire
+static void halCutoffDisarm(void) {
+  if (halCutoffTicksPerSec) halTargetCutoffStop();
+  halCutoffTicksLeft = 0;
+  halCutoffMicros = 0;
+}
+
+/*
+ * halCutoffTicks
+ * 
+ * ms in cutoff timer ticks, to the nearest tick - split so it can't overflow, and so a rate
+ * that isn't a whole number of ticks per millisecond (F_CPU/64 at 20MHz is 312.5) still comes
+ * out right.
+ */
+static unsigned long halCutoffTicks(unsigned long ms) {
+  return (ms * (halCutoffTicksPerSec / 1000UL)) + (((ms * (halCutoffTicksPerSec % 1000UL)) + 500UL) / 1000UL);
+}
+
+/*
+ * halCutoffCompare
+ * 
+ * The cutoff timer's compare interrupt - the board's handler calls this. If that was the last
+ * chunk, the inductor goes off, otherwise the compare moves along by the next one.
+ */
+void halCutoffCompare(void) {
+  unsigned long chunk;
+
+  if (halCutoffTicksLeft == 0) {
+    halTargetCutoffStop();
+    halInductorSwitch(false);
+    return;
+  }
+
+  chunk = (halCutoffTicksLeft > halCutoffChunkMax) ? halCutoffChunkMax : halCutoffTicksLeft;
+  halCutoffTicksLeft -= chunk;
+  halTargetCutoffNext(chunk);
+}
+
+
+/*
+ * halTickerBegin
+ * 
+ * Call handler from a timer interrupt every ms milliseconds. Returns false if there's no timer
+ * for it on this board, and the caller has to poll instead.
+ */
+boolean halTickerBegin(unsigned long ms, void (*handler)(void)) {
+  if (!halTargetTickerStart(ms, handler)) return false;
+
+  halTickerRunning = true;
+  return true;
+}
+
+
+/*
+ * halSleep
+ * 
+ * Stop the CPU until the next interrupt - the timers, ADC, UART, and I2C all keep running.
+ * Does nothing unless the ticker's running, since that's what guarantees we wake up again
+ * within its period, whatever else is (or isn't) going on.
+ */
+void halSleep(void) {
+  if (!halTickerRunning) return;
+
+  halTargetSleep();
+}
+
+
+/*
+ * halPinChangeBegin
+ * 
+ * Call handler from an interrupt whenever pin changes level - through the board's own pin
+ * change interrupts if it has them, otherwise attachInterrupt(). Returns false if the pin can't
+ * interrupt on this board, and the caller has to poll it instead.
+ */
+boolean halPinChangeBegin(uint8_t pin, void (*handler)(void)) {
+  if (halTargetPinChange(pin, handler)) return true;
+
+  #ifdef NOT_AN_INTERRUPT
+    if (digitalPinToInterrupt(pin) == NOT_AN_INTERRUPT) return false;
+  #endif
+
+  attachInterrupt(digitalPinToInterrupt(pin), handler, CHANGE);
+  return true;
+}
+
+
+/*
+ * halInductor
+ *
+ * Power the induction board on or off. The built-in LED follows the inductor, so there's a
+ * visual indication on the board itself. Switching it off also cancels any pending cutoff
+ * from halInductorArm().
+ */
+void halInductor(boolean on) {
+  if (!on) {
+    noInterrupts();
+    halCutoffDisarm();
+    halInductorSwitch(false);
+    interrupts();
+  }
+  else {
+    halInductorSwitch(true);
+  }
+}
+
+/*
+ * halInductorCutoff
+ *
+ * Switch the inductor off from inside an interrupt - same as halInductor(false), but without
+ * touching the interrupt enable, which the interrupt we're in has to take care of. The energy
+ * cutoff in the sampler uses this.
+ */
+void halInductorCutoff(void) {
+  halCutoffDisarm();
+  halInductorSwitch(false);
+}
+
+/*
+ * halInductorArm
+ *
+ * Power the inductor on for exactly ms milliseconds - the cutoff happens in the background.
+ * The timer starts after the pin goes up, so if anything the anneal runs a hair long, never
+ * short.
+ */
+void halInductorArm(unsigned long ms) {
+  unsigned long ticks, chunk;
+
+  halInductor(false); // clean slate
+
+  if (ms == 0) {
+    halInductorLastOnMicros = 0;
+    return;
+  }
+
+  if (!halCutoffTicksPerSec) {
+    halInductorSwitch(true);
+    halCutoffMicros = ms * 1000UL;
+    return;
+  }
+
+  ticks = halCutoffTicks(ms);
+  chunk = (ticks > halCutoffChunkMax) ? halCutoffChunkMax : ticks;
+
+  noInterrupts();
+  halCutoffTicksLeft = ticks - chunk;
+  halInductorSwitch(true);
+  halTargetCutoffStart(chunk);
+  interrupts();
+}
+
+/*
+ * halInductorExpired
+ *
+ * True once the inductor is off again - either the armed cutoff fired, or someone switched it
+ * off by hand.
+ */
+boolean halInductorExpired(void) {
+  if (halInductorIsOn && halCutoffMicros && ((micros() - halInductorStartMicros) >= halCutoffMicros)) {
+    halInductorSwitch(false);
+    halCutoffMicros = 0;
+  }
+  return !halInductorIsOn;
+}
+
+// microseconds the inductor was on, the last time it was switched off
+unsigned long halInductorOnTime(void) {
+  return halInductorLastOnMicros;
+}
+
+
+/*
+ * halSolenoid
+ *
+ * Open (true) or close (false) the trap door
+ */
+void halSolenoid(boolean open) {
+  digitalWrite(SOLENOID_PIN, open ? HIGH : LOW);
+}
+
+
+/*
+ * halCasePresent
+ *
+ * Returns true if opto sensor (OPTO_CASE_DETECT, or OPTO_SENSOR2 where there is one) sees a
+ * case - the pin reads LOW when there's a case sitting in front of it. Safe from an interrupt.
+ */
+boolean halCasePresent(uint8_t sensor) {
+  #ifdef OPTO2_PIN
+  if (sensor == OPTO_SENSOR2) return (digitalRead(OPTO2_PIN) == LOW);
+  #else
+  (void) sensor;
+  #endif
+  return (digitalRead(OPTO1_PIN) == LOW);
+}
+
+
+/*
+ * halAnalogRead
+ * 
+ * The background sampler reads the ADC from its timer interrupt, so anything reading it from
+ * the foreground holds interrupts off for the conversion - otherwise the sampler could barge in
+ * and switch channels halfway through.
+ * 
+ * The ADC shares one sample and hold capacitor between all its inputs, and the first
+ * conversion after switching pins still carries some of the last pin's charge - so whenever the
+ * pin isn't the one the ADC read last, that first conversion gets thrown away. The sampler
+ * switches pins every tick, so a foreground read right after one pays for the settle too.
+ */
+static uint8_t halAdcPin = 0xFF;      // the pin the ADC converted last - 0xFF, not a pin
+
+int halAnalogRead(uint8_t pin) {
+  int value;
+
+  noInterrupts();
+  value = halAnalogReadISR(pin);
+  interrupts();
+  return value;
+}
+
+// same, from the sampler's interrupt (or anywhere interrupts are already off) - turning them
+// back on in there would let the next tick in on top of us
+int halAnalogReadISR(uint8_t pin) {
+  if (pin != halAdcPin) {
+    (void) analogRead(pin); // settle
+    halAdcPin = pin;
+  }
+  return analogRead(pin);
+}
+
+/*
+ * halAnalogReadOversampled
+ *
+ * Oversample and decimate - read the pin 4^bits times, sum, and shift the sum back down by
+ * bits. With the normal noise on the line acting as dither, that buys bits more resolution than
+ * a single read, so the result runs from 0 to (RESOLUTION_MAX << bits) - 1, and averages the
+ * noise out at the same time. Interrupts are only held off one read at a time, so this never
+ * holds up the cutoff or the sampler for long.
+ */
+unsigned long halAnalogReadOversampled(uint8_t pin, uint8_t bits) {
+  unsigned long sum = 0;
+  unsigned int reads = 1 << (2 * bits);
+
+  for (unsigned int i = 0; i < reads; i++) {
+    sum += halAnalogRead(pin);
+  }
+  return sum >> bits;
+}
+
+// same, from the sampler's interrupt - interrupts stay off for the lot
+unsigned long halAnalogReadOversampledISR(uint8_t pin, uint8_t bits) {
+  unsigned long sum = 0;
+  unsigned int reads = 1 << (2 * bits);
+
+  for (unsigned int i = 0; i < reads; i++) {
+    sum += halAnalogReadISR(pin);
+  }
+  return sum >> bits;
+}
+
+#ifdef _AP3_VARIANT_H_
+// Apollo3 internal CPU temperature, in degrees C
+float halInternalTemp(void) {
+  float value;
+
+  noInterrupts();
+  value = getInternalTemp();
+  halAdcPin = 0xFF; // that moved the ADC off our pins
+  interrupts();
+  return value;
+}
+#endif
+
+
+unsigned long halMillis(void) {
+  return millis();
+}
+
+unsigned long halMicros(void) {
+  return micros();
+}
+
+void halDelay(unsigned long ms) {
+  delay(ms);
+}
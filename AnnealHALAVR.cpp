@@ -0,0 +1,111 @@
+/**************************************************************************************************
+ *
+ * AnnealHALAVR.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Timers, sleep, and pin change interrupts for the AVR boards - see AnnealHALTarget.h.
+ *
+ * Cutoff - Timer1 in normal mode at F_CPU/64 (4us ticks at 16MHz). It's only 16 bits, so long
+ *          anneals are chained in half-range chunks by moving the compare register along
+ * Ticker - Timer2 in CTC mode at F_CPU/1024. 8 bits, so the longest period is about 16ms at
+ *          16MHz, and the period is rounded to the nearest tick (9.984ms for 10)
+ * Sleep  - idle mode, the only one that leaves Timer0 (millis()) and Timer2 running
+ * Pins   - the few external interrupt pins go through attachInterrupt(), and everything else
+ *          through its port's pin change interrupt. Those fire for any pin on the port, so
+ *          there's one handler for all of them, and it has to work out what changed
+ *
+ **************************************************************************************************/
+
+#include "AnnealHALTarget.h"
+
+#if defined(__AVR__)
+
+#include <avr/sleep.h>
+
+#define HAL_TICKER_HZ         (F_CPU / 1024UL)
+
+const unsigned long halCutoffTicksPerSec = F_CPU / 64UL;
+const unsigned long halCutoffChunkMax = 0x8000UL;
+
+static void (*halTickerHandler)(void) = NULL;
+static void (*halPinChangeHandler)(void) = NULL;
+
+
+void halTargetCutoffStart(unsigned long ticks) {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS11) | _BV(CS10); // normal mode, F_CPU/64
+  TCNT1 = 0;
+  OCR1A = ticks;
+  TIFR1 = _BV(OCF1A);
+  TIMSK1 |= _BV(OCIE1A);
+}
+
+void halTargetCutoffNext(unsigned long ticks) {
+  OCR1A += ticks;
+}
+
+void halTargetCutoffStop(void) {
+  TIMSK1 &= ~_BV(OCIE1A);
+}
+
+ISR(TIMER1_COMPA_vect) {
+  halCutoffCompare();
+}
+
+
+boolean halTargetTickerStart(unsigned long ms, void (*handler)(void)) {
+  unsigned long ticks = (HAL_TICKER_HZ * ms + 500UL) / 1000UL;
+
+  if ((ticks == 0) || (ticks > 256)) return false;
+
+  noInterrupts();
+  halTickerHandler = handler;
+  TCCR2A = _BV(WGM21);                          // CTC
+  TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);   // F_CPU/1024
+  TCNT2 = 0;
+  OCR2A = ticks - 1;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 |= _BV(OCIE2A);
+  interrupts();
+  return true;
+}
+
+ISR(TIMER2_COMPA_vect) {
+  if (halTickerHandler) halTickerHandler();
+}
+
+
+void halTargetSleep(void) {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+}
+
+
+boolean halTargetPinChange(uint8_t pin, void (*handler)(void)) {
+  if ((digitalPinToInterrupt(pin) != NOT_AN_INTERRUPT) || !digitalPinToPCICR(pin)) return false;
+
+  noInterrupts();
+  halPinChangeHandler = handler;
+  *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+  PCIFR = _BV(digitalPinToPCICRbit(pin));       // same bit layout as PCICR
+  *digitalPinToPCICR(pin) |= _BV(digitalPinToPCICRbit(pin));
+  interrupts();
+  return true;
+}
+
+#ifdef PCINT0_vect
+ISR(PCINT0_vect) { if (halPinChangeHandler) halPinChangeHandler(); }
+#endif
+#ifdef PCINT1_vect
+ISR(PCINT1_vect) { if (halPinChangeHandler) halPinChangeHandler(); }
+#endif
+#ifdef PCINT2_vect
+ISR(PCINT2_vect) { if (halPinChangeHandler) halPinChangeHandler(); }
+#endif
+#ifdef PCINT3_vect
+ISR(PCINT3_vect) { if (halPinChangeHandler) halPinChangeHandler(); }
+#endif
+
+#endif // __AVR__
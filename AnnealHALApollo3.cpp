@@ -0,0 +1,100 @@
+/**************************************************************************************************
+ *
+ * AnnealHALApollo3.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Timers, sleep, and pin change interrupts for the SparkFun Artemis (Apollo3) - see
+ * AnnealHALTarget.h.
+ *
+ * Cutoff - CTIMER 3, both halves linked into one 32-bit counter, clocked from the same 3MHz
+ *          HFRC tap that millis() uses, so the cutoff is exactly as accurate as our clock. 32
+ *          bits of 3MHz is over 23 minutes, so it never needs chaining
+ * Ticker - CTIMER 2, A half on its own, repeating off the same tap
+ * Sleep  - normal sleep (WFI), not deep sleep, which would stop the HFRC our timers run on
+ * Pins   - any pin can interrupt on CHANGE, so attachInterrupt() does it all
+ *
+ **************************************************************************************************/
+
+#include "AnnealHALTarget.h"
+
+#if defined(_AP3_VARIANT_H_)
+
+#define HAL_CUTOFF_TIMER      3
+#define HAL_CUTOFF_INT        AM_HAL_CTIMER_INT_TIMERA3C0
+#define HAL_TICKER_TIMER      2
+#define HAL_TICKER_INT        AM_HAL_CTIMER_INT_TIMERA2C0
+#define HAL_TIMER_HZ          3000000UL
+
+const unsigned long halCutoffTicksPerSec = HAL_TIMER_HZ;
+const unsigned long halCutoffChunkMax = 0xFFFFFFFFUL;
+
+
+static void halCutoffISR(void) {
+  am_hal_ctimer_stop(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+  halCutoffCompare();
+}
+
+// Weak, so if the core ever grows its own CTIMER dispatcher that one wins, and it services our
+// registered handler the same way.
+extern "C" void __attribute__((weak)) am_ctimer_isr(void) {
+  uint32_t status = am_hal_ctimer_int_status_get(false);
+  am_hal_ctimer_int_clear(status);
+  am_hal_ctimer_int_service(status);
+}
+
+
+void halTargetCutoffStart(unsigned long ticks) {
+  am_hal_ctimer_clear(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+  am_hal_ctimer_config_single(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH,
+                              AM_HAL_CTIMER_FN_ONCE | AM_HAL_CTIMER_HFRC_3MHZ | AM_HAL_CTIMER_INT_ENABLE);
+  am_hal_ctimer_period_set(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH, ticks, 0);
+  am_hal_ctimer_int_register(HAL_CUTOFF_INT, halCutoffISR);
+  am_hal_ctimer_int_clear(HAL_CUTOFF_INT);
+  am_hal_ctimer_int_enable(HAL_CUTOFF_INT);
+  NVIC_EnableIRQ(CTIMER_IRQn);
+  am_hal_ctimer_start(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+}
+
+// a one-shot that's fired is stopped, so just run it again - never happens with 32 bits
+void halTargetCutoffNext(unsigned long ticks) {
+  am_hal_ctimer_clear(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+  am_hal_ctimer_period_set(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH, ticks, 0);
+  am_hal_ctimer_start(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+}
+
+void halTargetCutoffStop(void) {
+  am_hal_ctimer_int_disable(HAL_CUTOFF_INT);
+  am_hal_ctimer_stop(HAL_CUTOFF_TIMER, AM_HAL_CTIMER_BOTH);
+  am_hal_ctimer_int_clear(HAL_CUTOFF_INT);
+}
+
+
+boolean halTargetTickerStart(unsigned long ms, void (*handler)(void)) {
+  am_hal_ctimer_stop(HAL_TICKER_TIMER, AM_HAL_CTIMER_TIMERA);
+  am_hal_ctimer_clear(HAL_TICKER_TIMER, AM_HAL_CTIMER_TIMERA);
+  am_hal_ctimer_config_single(HAL_TICKER_TIMER, AM_HAL_CTIMER_TIMERA,
+                              AM_HAL_CTIMER_FN_REPEAT | AM_HAL_CTIMER_HFRC_3MHZ | AM_HAL_CTIMER_INT_ENABLE);
+  am_hal_ctimer_period_set(HAL_TICKER_TIMER, AM_HAL_CTIMER_TIMERA, (ms * (HAL_TIMER_HZ / 1000UL)) - 1, 0);
+  am_hal_ctimer_int_register(HAL_TICKER_INT, handler);
+  am_hal_ctimer_int_clear(HAL_TICKER_INT);
+  am_hal_ctimer_int_enable(HAL_TICKER_INT);
+  NVIC_EnableIRQ(CTIMER_IRQn);
+  am_hal_ctimer_start(HAL_TICKER_TIMER, AM_HAL_CTIMER_TIMERA);
+  return true;
+}
+
+
+void halTargetSleep(void) {
+  am_hal_sysctrl_sleep(AM_HAL_SYSCTRL_SLEEP_NORMAL);
+}
+
+
+boolean halTargetPinChange(uint8_t pin, void (*handler)(void)) {
+  (void) pin;
+  (void) handler;
+  return false;
+}
+
+#endif // _AP3_VARIANT_H_
@@ -0,0 +1,48 @@
+/**************************************************************************************************
+ *
+ * AnnealHALOther.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Timers, sleep, and pin change interrupts for any board that isn't an Artemis or an AVR - see
+ * AnnealHALTarget.h. There aren't any: AnnealHAL.cpp polls a micros() deadline for the cutoff,
+ * which is the same one-loop-pass resolution we always had, the sampler polls for its ticks,
+ * halSleep() returns right away, and only pins attachInterrupt() can take will interrupt.
+ *
+ **************************************************************************************************/
+
+#include "AnnealHALTarget.h"
+
+#if !defined(_AP3_VARIANT_H_) && !defined(__AVR__)
+
+const unsigned long halCutoffTicksPerSec = 0;
+const unsigned long halCutoffChunkMax = 0;
+
+void halTargetCutoffStart(unsigned long ticks) {
+  (void) ticks;
+}
+
+void halTargetCutoffNext(unsigned long ticks) {
+  (void) ticks;
+}
+
+void halTargetCutoffStop(void) {
+}
+
+boolean halTargetTickerStart(unsigned long ms, void (*handler)(void)) {
+  (void) ms;
+  (void) handler;
+  return false;
+}
+
+void halTargetSleep(void) {
+}
+
+boolean halTargetPinChange(uint8_t pin, void (*handler)(void)) {
+  (void) pin;
+  (void) handler;
+  return false;
+}
+
+#endif
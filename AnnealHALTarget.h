@@ -0,0 +1,56 @@
+/**************************************************************************************************
+ *
+ * AnnealHALTarget.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The part of the hardware abstraction layer that has to touch registers - the inductor cutoff
+ * timer, the sampler's ticker, sleep, and pin change interrupts - with one small file per board:
+ *
+ *   AnnealHALApollo3.cpp   SparkFun Artemis (Apollo3) - CTIMER 2 and 3
+ *   AnnealHALAVR.cpp       AVR boards - Timer1, Timer2, and the PCINT vectors
+ *   AnnealHALOther.cpp     anything else - no timers, so AnnealHAL.cpp polls
+ *
+ * Each is wrapped in its own #if, so the IDE can build all three and only one has anything in
+ * it. Everything else - the pins, the ADC, and the cutoff's bookkeeping - is in AnnealHAL.cpp,
+ * the same on every board. The host simulation (extras/HostSim) builds AnnealHAL.cpp as is, and
+ * swaps only these three for HostHALTarget.cpp.
+ *
+ * Nothing outside the HAL should need this - the sketch uses the hal* functions in
+ * Annealer-Control.h.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_HAL_TARGET_H
+#define _ANNEAL_HAL_TARGET_H
+
+#include "Annealer-Control.h"
+
+/*
+ * Inductor cutoff timer
+ *
+ * A counter that starts at 0 on halTargetCutoffStart() and counts halCutoffTicksPerSec, with a
+ * compare interrupt that calls halCutoffCompare(). A compare can only be so far out -
+ * halCutoffChunkMax ticks - so AnnealHAL.cpp chains longer ones, moving the compare along from
+ * inside the interrupt with halTargetCutoffNext(). halCutoffTicksPerSec is 0 if there's no
+ * timer, and then none of the three get called.
+ */
+extern const unsigned long halCutoffTicksPerSec;
+extern const unsigned long halCutoffChunkMax;
+
+void halTargetCutoffStart(unsigned long ticks);
+void halTargetCutoffNext(unsigned long ticks);    // ticks after the compare that just fired
+void halTargetCutoffStop(void);                   // no more compare interrupts
+void halCutoffCompare(void);                      // AnnealHAL.cpp
+
+// handler every ms from a timer interrupt - false if there's no timer for it
+boolean halTargetTickerStart(unsigned long ms, void (*handler)(void));
+
+// stop the CPU until the next interrupt, with the timers still running
+void halTargetSleep(void);
+
+// a pin change interrupt where attachInterrupt() can't - false to leave it to attachInterrupt()
+boolean halTargetPinChange(uint8_t pin, void (*handler)(void));
+
+#endif // _ANNEAL_HAL_TARGET_H
@@ -15,33 +15,30 @@
 
  
 #include "Annealer-Control.h"
-#include <avr/dtostrf.h>
+#include "AnnealFormat.h"
 #include <Chrono.h>
 #include <SerLCD.h>
 
-String output;
-int LCDquotient = 0;
-int LCDremainder = 0;
-int timerCurrent = 0;
-
 
 /*
  * updateLCD
  * 
  * Arguments
  * 
- * boolean full - write the whole screen?
+ * boolean full - clear the display and redraw the labels, too?
  * 
  * Refresh the LCD - this code will get called in a couple places, so a subroutine makes sense.
- * This code is a little tedious - again, trying to leave printf out of the picture. Also, there
- * are preprocessor defines here (rather than above) - just keeping them local for ease of
- * reference and manipulation. 
+ * Still leaving printf out of the picture - the number fields go through the fixed width
+ * formatters in AnnealFormat.h, into stack buffers, so there's no heap traffic per refresh.
  * 
  * Right now, this is just a basic display. Eventually, this should become a menu system of some
  * kind, rather than just a simple data display.
  * 
  * The LCD is 20x4
  * 
+ * Everything here writes into the shadow framebuffer (AnnealLCDBuffer.cpp) - nothing goes out
+ * over I2C until lcdBufFlush(), and then only the characters that changed.
+ * 
  * Try to do this as lightweight as possible. Here's the layout:
  * 
  * 01234567890123456789  <-- column numbers, not printed!!
@@ -49,6 +46,8 @@ int timerCurrent = 0;
  * Amp 00.00 Volt 00.00
  * Thrm 00.0 IntT  00.0  <-- IntT is only for Apollo3 architecture
  * State: xxxxxxxxxxxxx      TMax is shown, otherwise
+ * 
+ * During a batch, the State line is the batch readout instead - see AnnealBatch.cpp
  */
 void updateLCD(boolean full) {
   
@@ -56,220 +55,120 @@ void updateLCD(boolean full) {
   Serial.println(F("DEBUG: updating the full LCD"));
   #endif
 
-  String outputFull;
-  outputFull = "";
-
   if (full) {
-    lcd.clear();
-    lcd.setCursor(LCD_SETPOINT_LABEL);
-    
-    outputFull.concat(F("Set "));
-    updateLCDSetPoint(false);
-    outputFull.concat(output);
-    outputFull.concat(F(" Time "));
-    updateLCDTimer(false);
-    outputFull.concat(output);
-    lcd.print(outputFull);
-    #ifdef DEBUG_LCD
-    Serial.println(outputFull);
+    lcdBufReset();
+    lcdBufPrint(LCD_SETPOINT_LABEL, F("Set"));
+    lcdBufPrint(LCD_TIMER_LABEL, F(" Time"));
+    lcdBufPrint(LCD_CURRENT_LABEL, F("Amp"));
+    lcdBufPrint(LCD_VOLTAGE_LABEL, F(" Volt"));
+    lcdBufPrint(LCD_THERM1_LABEL, F("Thrm"));
+    #ifdef _AP3_VARIANT_H_
+    lcdBufPrint(LCD_2NDTEMP_LABEL, F(" IntT"));
+    #else
+    lcdBufPrint(LCD_2NDTEMP_LABEL, F(" TMax"));
     #endif
-
-    outputFull = "";
-
-    // not sure why I need to do this, yet - the text "Amp "
-    // doesn't print out, otherwise...
-    lcd.setCursor(LCD_CURRENT_LABEL);
-    lcd.print(F("Amp "));
-    lcd.setCursor(LCD_CURRENT_LABEL);
-    outputFull.concat(F("Amp "));
-    updateLCDPowerDisplay("false");
-    outputFull.concat(output);
-    #ifdef DEBUG_LCD
-    Serial.println(outputFull);
-    #endif
-    lcd.print(outputFull);
-
-
-    outputFull = "";
-    lcd.setCursor(LCD_THERM1_LABEL);
-    outputFull.concat(F("Thrm "));
-    updateLCDTemps(false);
-    outputFull.concat(output);
-    lcd.print(outputFull);
-    #ifdef DEBUG_LCD
-    Serial.println(outputFull);
-    #endif
-    
-    lcd.setCursor(LCD_STATE_LABEL);
-    lcd.print(F("State:"));
-
-    updateLCDState();
-  }
-  else {
-    updateLCDSetPoint(true);
-    updateLCDTimer(true);
-    updateLCDPowerDisplay(true);
-    updateLCDTemps(true);
-    updateLCDState();
+    lcdBufPrint(LCD_STATE_LABEL, F("State:"));
   }
+
+  updateLCDSetPoint();
+  updateLCDTimer();
+  updateLCDPowerDisplay();
+  updateLCDTemps();
+  updateLCDState();
   
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: done updating LCD"));
   #endif
 }
 
-// no boolean, here - we're likely always going to just do this
+// no boolean, here - we're likely always going to just do this. In batch mode, the whole line
+// is the batch readout instead (AnnealBatch.cpp). The label goes out every time, so switching
+// back costs nothing extra - the shadow buffer drops anything that didn't change
 void updateLCDState() {
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: LCD: print state"));
   #endif
-  lcd.setCursor(LCD_STATE);
-  lcd.print(annealStateDesc[annealState]);
+
+  if (batchTarget) {
+    char c[LCD_COLS + 1];
+    lcdBufPrint(LCD_STATE_LABEL, batchFormatStatus(c));
+  }
+  else {
+    lcdBufPrint(LCD_STATE_LABEL, F("State: "));
+    lcdBufPrint(LCD_STATE, annealStateDesc[annealState]);
+  }
 
 
 }
 
 
-// set point is in hundredths of seconds! if it's less than 999, we need a space
-void updateLCDSetPoint(boolean sendIt) {
+// set point is in seconds, shown to hundredths
+void updateLCDSetPoint(void) {
   
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: LCD: print set point"));
   #endif
   char c[6];
 
-  output = "";
-
-  dtostrf(annealSetPoint, 5, 2, c);
-  output.concat(c);
-
-  if (sendIt) {
-    lcd.setCursor(LCD_SETPOINT);
-    lcd.print(output);
-  }
+  lcdBufPrint(LCD_SETPOINT, formatFixed<5,2>(c, annealSetPoint));
 
 }
 
-// print most of the line at once! Save's us a cursor reposition and a print
-void updateLCDPowerDisplay(boolean sendIt) {
+void updateLCDPowerDisplay(void) {
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: LCD: print amps and volts"));
   #endif
 
-  output = "";
-
-  LCDremainder = (int) (amps * 100);
-  LCDquotient = LCDremainder / 100;
-  LCDremainder = LCDremainder % 100;
-  if (LCDquotient < 10) output.concat(F(" "));
-  output.concat(LCDquotient);
-  output.concat(F("."));
-  if (LCDremainder < 10) output.concat(F("0"));
-  output.concat(LCDremainder);
-
-  output.concat(F(" Volt "));
+  char c[6];
 
-  LCDremainder = (int) (volts * 100);
-  LCDquotient = LCDremainder / 100;
-  LCDremainder = LCDremainder % 100;
-  if (LCDquotient < 10) output.concat(F(" "));
-  output.concat(LCDquotient);
-  output.concat(F("."));
-  if (LCDremainder < 10) output.concat(F("0"));
-  output.concat(LCDremainder);
+  lcdBufPrint(LCD_CURRENT, formatFixed<5,2>(c, amps));
+  lcdBufPrint(LCD_VOLTAGE, formatFixed<5,2>(c, volts));
 
-  #ifdef DEBUG_LCD
-  Serial.print(F("DEBUG: updateLCDPowerDisplay output: ")); Serial.println(output);
+  #ifdef DEBUG_COSTMODEL
+  costModelCharge(COSTMODEL_LCD_MICROS);
   #endif
-
-  if (sendIt) {
-    lcd.setCursor(LCD_CURRENT);
-    lcd.print(output);
-  }
-
   
 }
 
-void updateLCDTemps(boolean sendIt) {
+// temperatures get one decimal place, unless they hit triple digits
+void updateLCDTemps(void) {
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: LCD: print temperatures"));
   #endif
 
-  output = "";
+  char c[5];
 
-  LCDremainder = (int) (Therm1Temp * 10);
-  LCDquotient = LCDremainder / 10;
-  LCDremainder = LCDremainder % 10;
-  if (LCDquotient >= 100) {
-    output.concat(F(" "));
-    output.concat(LCDquotient);
-  }
-  else {
-    if (LCDquotient < 10) output.concat(F(" "));
-    output.concat(LCDquotient);
-    output.concat(F("."));
-    output.concat(LCDremainder); // should be less than 10
-  }
+  lcdBufPrint(LCD_THERM1, formatFixed<4,1>(c, Therm1Temp));
 
   #ifdef _AP3_VARIANT_H_
-  output.concat(F(" IntT  ")); 
-  LCDremainder = (int) (internalTemp * 10);
+  lcdBufPrint(LCD_2NDTEMP, formatFixed<4,1>(c, internalTemp));
   #else
-  output.concat(F(" TMax  "));
-  LCDremainder = (int) (Therm1TempHigh * 10);  
+  lcdBufPrint(LCD_2NDTEMP, formatFixed<4,1>(c, Therm1TempHigh));
   #endif
   
-  LCDquotient = LCDremainder / 10;
-  LCDremainder = LCDremainder % 10;
-
-  if (LCDquotient >= 100) {
-    output.concat(F(" "));
-    output.concat(LCDquotient);
-  }
-  else {
-    if (LCDquotient < 10) output.concat(F(" "));
-    output.concat(LCDquotient);
-    output.concat(F("."));
-    output.concat(LCDremainder); // should be less than 10
-  }
-  if (sendIt) {
-    lcd.setCursor(LCD_THERM1);
-    lcd.print(output);
-  }
-  
 }
 
 
-void updateLCDTimer(boolean sendIt) {
+void updateLCDTimer(void) {
   #ifdef DEBUG_LCD
   Serial.println(F("DEBUG: LCD: print timer"));
   #endif
   
-  output = "";
-
+  char c[6];
   
   // if we're running a timer, do the math to print the right value, otherwise, a default
   if (annealState == START_ANNEAL || 
       annealState == ANNEAL_TIMER ) {
-        
-    timerCurrent = Timer.elapsed();
-    LCDquotient = timerCurrent / 1000;
-    LCDremainder = timerCurrent % 1000 / 10;
-    if (LCDquotient < 10) output.concat(F(" "));
-    output.concat(LCDquotient);
-    output.concat(F("."));
-    if (LCDremainder < 10) output.concat(F("0"));
-    output.concat(LCDremainder);
+    lcdBufPrint(LCD_TIMER, formatScaled<5,2>(c, Timer.elapsed() / 10));
   }
   else {
     // this is for all the wait states *AND* DROP_CASE, so we can show 0.00 at 
     // timer start
-    output.concat(F(" 0.00"));
+    lcdBufPrint(LCD_TIMER, F(" 0.00"));
   }
 
-  if (sendIt) {
-    lcd.setCursor(LCD_TIMER);
-    lcd.print(output);
-  }
+  #ifdef DEBUG_COSTMODEL
+  costModelCharge(COSTMODEL_LCD_MICROS);
+  #endif
   
 }
@@ -0,0 +1,182 @@
+/**************************************************************************************************
+ *
+ * AnnealLCDBuffer.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Shadow framebuffer for the 20x4 LCD. The annealing and Mayan screens write into lcdShadow
+ * instead of talking to the display, and lcdBufFlush() sends only what changed since the last
+ * flush.
+ *
+ * Over I2C, the SerLCD is expensive in a lopsided way - every setCursor is a "special command"
+ * that the library follows with a long settle delay, while a run of characters goes out in a
+ * single transaction. So the flush sends at most one run per row, from the first changed
+ * character to the last, and skips the setCursor entirely when the display cursor is already
+ * sitting where the run starts. Resending a few unchanged characters in the middle of a run is
+ * far cheaper than a second cursor move.
+ *
+ * The ArduinoMenu system still drives the LCD directly - whenever we take the screen back from
+ * it, call lcdBufReset() so we stop trusting what we think is on the glass.
+ * 
+ * The shadow also works as our LCD transmit queue - it's bounded (80 characters plus one
+ * pending backlight color), and repeated writes to the same spot just coalesce. loop() drains
+ * it with a per-pass budget, in estimated microseconds of blocking I2C time, so the expensive
+ * part of a display update gets spread over several passes instead of landing all at once in
+ * a state where timing matters. Rows are serviced round-robin, so a field that changes every
+ * pass (the anneal timer) can't starve the rest of the screen.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+#include <avr/pgmspace.h>
+#include <SerLCD.h>
+
+char lcdShadow[LCD_ROWS][LCD_COLS];   // what we want on the display
+char lcdShown[LCD_ROWS][LCD_COLS];    // what we've actually sent it
+
+int lcdCursorCol = -1;                // where the display's cursor is, or -1 if we don't know
+int lcdCursorRow = -1;
+
+uint8_t lcdFlushRow = 0;              // first row to look at on the next flush
+
+boolean lcdBacklightPending = false;
+uint8_t lcdBacklightRed = 0;
+uint8_t lcdBacklightGreen = 0;
+uint8_t lcdBacklightBlue = 0;
+uint32_t lcdBacklightShown = 0xFFFFFFFF; // packed RGB we last sent - nothing valid, to start
+
+
+/*
+ * lcdBufReset
+ *
+ * Clear the real display, and both buffers to match. Use this for full redraws, and any time
+ * something other than us has been writing to the LCD.
+ */
+void lcdBufReset(void) {
+  lcd.clear();
+  memset(lcdShadow, ' ', sizeof(lcdShadow));
+  memset(lcdShown, ' ', sizeof(lcdShown));
+  lcdCursorCol = 0;
+  lcdCursorRow = 0;
+}
+
+// blank the shadow - the next flush erases whatever's changed on the display
+void lcdBufClear(void) {
+  memset(lcdShadow, ' ', sizeof(lcdShadow));
+}
+
+
+/*
+ * lcdBufPrint
+ *
+ * Copy a string into the shadow at col, row. Anything past the end of the row is dropped -
+ * no wrapping, just like the display.
+ */
+void lcdBufPrint(uint8_t col, uint8_t row, const char *s) {
+  if (row >= LCD_ROWS) return;
+
+  while (*s && (col < LCD_COLS)) {
+    lcdShadow[row][col++] = *s++;
+  }
+}
+
+void lcdBufPrint(uint8_t col, uint8_t row, const __FlashStringHelper *fs) {
+  const char *s = (const char *) fs;
+  char ch;
+
+  if (row >= LCD_ROWS) return;
+
+  while ((ch = pgm_read_byte(s++)) && (col < LCD_COLS)) {
+    lcdShadow[row][col++] = ch;
+  }
+}
+
+
+/*
+ * lcdBufBacklight
+ *
+ * Queue a backlight color change - it goes out with the next flush. If the color changes again
+ * before then, only the last one gets sent, and asking for the color that's already showing
+ * costs nothing.
+ */
+void lcdBufBacklight(uint8_t red, uint8_t green, uint8_t blue) {
+  lcdBacklightRed = red;
+  lcdBacklightGreen = green;
+  lcdBacklightBlue = blue;
+  lcdBacklightPending = ((((uint32_t) red << 16) | ((uint32_t) green << 8) | blue) != lcdBacklightShown);
+}
+
+
+/*
+ * lcdBufFlush
+ *
+ * Arguments:
+ * budget - estimated microseconds of LCD time we're allowed to spend on this pass
+ * 
+ * Send the differences between lcdShadow and lcdShown to the display - one setCursor (at most)
+ * and one write per row that changed, for as many rows as fit in the budget. Whatever doesn't
+ * fit stays dirty and goes out on a later pass.
+ */
+void lcdBufFlush(unsigned long budget) {
+
+  if (lcdBacklightPending) {
+    if (LCD_COST_BACKLIGHT > budget) return;
+
+    lcd.setFastBacklight(lcdBacklightRed, lcdBacklightGreen, lcdBacklightBlue);
+    lcdBacklightShown = ((uint32_t) lcdBacklightRed << 16) | ((uint32_t) lcdBacklightGreen << 8) | lcdBacklightBlue;
+    lcdBacklightPending = false;
+    budget -= LCD_COST_BACKLIGHT;
+  }
+
+  for (uint8_t i = 0; i < LCD_ROWS; i++) {
+    uint8_t row = (lcdFlushRow + i) % LCD_ROWS;
+    unsigned long cost;
+    int first = -1;
+    int last = -1;
+
+    for (uint8_t col = 0; col < LCD_COLS; col++) {
+      if (lcdShadow[row][col] != lcdShown[row][col]) {
+        if (first < 0) first = col;
+        last = col;
+      }
+    }
+
+    if (first < 0) continue; // nothing changed on this row
+
+    cost = LCD_COST_WRITE + (LCD_COST_CHAR * (last - first + 1));
+    if ((lcdCursorRow != row) || (lcdCursorCol != first)) {
+      cost += LCD_COST_CURSOR;
+    }
+
+    if (cost > budget) {  // out of time - this row goes first next pass
+      lcdFlushRow = row;
+      return;
+    }
+    budget -= cost;
+
+    if ((lcdCursorRow != row) || (lcdCursorCol != first)) {
+      lcd.setCursor(first, row);
+    }
+
+    lcd.write((const uint8_t *) &lcdShadow[row][first], last - first + 1);
+    memcpy(&lcdShown[row][first], &lcdShadow[row][first], last - first + 1);
+
+    #ifdef DEBUG_LCD
+    Serial.print(F("DEBUG: LCD flush row ")); Serial.print(row);
+    Serial.print(F(" cols ")); Serial.print(first); Serial.print(F("-")); Serial.println(last);
+    #endif
+
+    // the display advances its cursor as it writes, but doesn't wrap to the next row in any
+    // way we can count on
+    lcdCursorRow = row;
+    lcdCursorCol = (last + 1 < LCD_COLS) ? last + 1 : -1;
+  }
+
+  lcdFlushRow = (lcdFlushRow + 1) % LCD_ROWS;
+}
+
+// true if there's anything lcdBufFlush() hasn't sent yet
+boolean lcdBufPending(void) {
+  return lcdBacklightPending || (memcmp(lcdShadow, lcdShown, sizeof(lcdShadow)) != 0);
+}
@@ -7,7 +7,8 @@
  * 
  * This file contains functions that allow use of a SparkFun Qwiic OpenLog device to log data  
  * from various operations. Currently, this is only for Mayan runs, so we can examine the 
- * data later via graphs, spreadsheets, and all that fun.
+ * data later via graphs, spreadsheets, and all that fun. Annealing batches get a one line
+ * summary apiece, in BATCH_LOG_FILE.
  * 
  * Requires SparkFun's Qwiic OpenLog library, and the device.
  * 
@@ -15,19 +16,88 @@
  * sense of date/time (and it isn't needed for this project, anyway). So, we'll use an incrementing
  * integer to pick a filename to log to. Each analysis run may consist of one or more cases - we'll
  * log all of that data into the same file. When a run is finished, the file is closed and we
- * reset. When we start, we figure out the highest number CSV file on the disk, add one to the number
- * and use that as our log file name.
- *  * 
+ * reset. The next number to use is kept in EEPROM, so starting a file doesn't depend on how many
+ * are already on the card - we only fall back to scanning the directory for the highest number 
+ * if that file turns out to exist already.
+ * 
+ * Writes are streamed - annealLogWrite() only copies a line into one of two small blocks, and 
+ * annealLogService(), a scheduler job every LOG_PACE_MS, sends a finished block to the OpenLog
+ * when the pacing interval allows. One block fills while the other drains, so a Mayan run can
+ * log each sample as it's taken without ever waiting on the card. annealLogFlush() pushes out 
+ * whatever's left, when we're done.
+ * 
  **************************************************************************************************/
 
 #include "Annealer-Control.h" // includes necessary libraries!
+#include "AnnealFormat.h"
+#include "AnnealLogFormat.h"
 
 OpenLog annealLog;
 
+char logBlock[2][LOG_BLOCK_SIZE];
+uint8_t logFillBlock = 0;             // block annealLogWrite() is adding to
+uint8_t logFillLength = 0;
+uint8_t logDrainLength = 0;           // bytes waiting in the other block - 0 if it's free
+unsigned long logLastWriteMillis = 0;
+
+uint16_t logCycle = 0;                // current case, and its last sample, for delta coding
+uint16_t logLastTimestamp = 0;
+uint16_t logLastAmps = 0;
+uint16_t logLastVolts = 0;
+
+static void annealLogQueue(const uint8_t *data, uint8_t length);
+
+
+// "<n>.BIN", or .CSV
+static String annealLogFileName(uint16_t fileNum) {
+  char name[13];
+  strcpy(formatUnsigned(name, fileNum), LOG_FILE_EXT);
+  return String(name);
+}
+
+/*
+ * annealLogScanHighest
+ * 
+ * The slow way - list all the log files on the card and return the highest number we find. Only
+ * needed when the sequence number in EEPROM can't be trusted.
+ */
+static uint16_t annealLogScanHighest(void) {
+  uint16_t highestFileNum = 0;
+
+  annealLog.searchDirectory("*" LOG_FILE_EXT);
+
+  String fileName = annealLog.getNextDirectoryItem();
+  while (fileName != "") {
+    // strip the extension
+    
+    #ifdef DEBUG
+    Serial.print(F("DEBUG: LOG: file in dir "));
+    Serial.println(fileName);
+    #endif
+    
+    fileName.remove(fileName.length() - 4); // LOG_FILE_EXT
+
+    #ifdef DEBUG
+    Serial.print(F("DEBUG: LOG: file name minus extension "));
+    Serial.println(fileName);
+    #endif
+
+    long filenum = fileName.toInt();
+
+    if (filenum > highestFileNum) { 
+      highestFileNum = filenum; 
+    }
+    
+    fileName = annealLog.getNextDirectoryItem();
+  }
+
+  return highestFileNum;
+}
+
 void annealLogStartNewFile(void) {
   // set mayanUseSD to false if we fail in here
   byte status = annealLog.getStatus();
-  int highestFileNum = 0;
+  uint16_t fileNum = eepromGetLogSequence();
 
   if (status == 0xFF) {
     // we're toast
@@ -50,38 +120,23 @@ void annealLogStartNewFile(void) {
     return;
   }
 
-  // list all .CSV files and find the highest numbered one
-  annealLog.searchDirectory("*.CSV");
-
-  String fileName = annealLog.getNextDirectoryItem();
-  while (fileName != "") {
-    // strip the extension
-    
-    #ifdef DEBUG
-    Serial.print(F("DEBUG: LOG: file in dir "));
-    Serial.println(fileName);
-    #endif
-    
-    fileName.remove(fileName.length() - 4); // ".CSV"
-
+  // normally, the next file number is waiting for us in EEPROM - but if that file's already on
+  // the card (a different card, or EEPROM that got reset), go count what's there
+  if ((fileNum == 0) || (annealLog.size(annealLogFileName(fileNum)) >= 0)) {
     #ifdef DEBUG
-    Serial.print(F("DEBUG: LOG: file name minus extension "));
-    Serial.println(fileName);
+    Serial.print(F("DEBUG: LOG: can't use stored file number "));
+    Serial.print(fileNum);
+    Serial.println(F(" - scanning the card"));
     #endif
 
-    int filenum = fileName.toInt();
-
-    if (filenum > highestFileNum) { 
-      highestFileNum = filenum; 
-    }
-    
-    fileName = annealLog.getNextDirectoryItem();
+    fileNum = annealLogScanHighest() + 1;
   }
 
-  // increment that number by one and start our new file
-  highestFileNum++;
-  String newFileName = String(highestFileNum);
-  newFileName.concat(F(".CSV"));
+  // nothing left over from the last file should land in this one
+  logFillLength = 0;
+  logDrainLength = 0;
+
+  String newFileName = annealLogFileName(fileNum);
 
   #ifdef DEBUG
   Serial.print(F("DEBUG: LOG: opening file "));
@@ -95,17 +150,271 @@ void annealLogStartNewFile(void) {
     #endif
     
   }
+  else {
+    eepromStoreLogSequence(fileNum + 1);
+
+    #ifndef LOG_FORMAT_CSV
+    uint8_t header[LOG_HEADER_LENGTH] = { LOG_MAGIC_0, LOG_MAGIC_1, LOG_MAGIC_2, LOG_MAGIC_3, LOG_FORMAT_VERSION, 0 };
+    annealLogQueue(header, LOG_HEADER_LENGTH);
+    #endif
+  }
   
 }
 
 void annealLogCloseFile(void) {
-  annealLog.syncFile();
+  annealLogFlush();
   // not sure there's anything else to do - we're dependent on the calling end
   // to decide when to make the new file, and OpenLog will continue to use the
   // same file until told to do otherwise
 }
 
-void annealLogWrite(String s) {
-  annealLog.println(s);
-  delay(15); // prevents us from overrunning the OpenLog's buffer
+
+/*
+ * annealLogSendBlock
+ * 
+ * Send the drain block to the OpenLog, and mark it free. This is the only place that actually
+ * writes to the device.
+ */
+static void annealLogSendBlock(void) {
+  annealLog.write((const uint8_t *) logBlock[logFillBlock ^ 1], logDrainLength);
+  logDrainLength = 0;
+  logLastWriteMillis = halMillis();
+}
+
+// hand the fill block over to be drained, and start filling the other one
+static void annealLogSwap(void) {
+  logDrainLength = logFillLength;
+  logFillLength = 0;
+  logFillBlock ^= 1;
+}
+
+
+/*
+ * annealLogQueue
+ * 
+ * Queue bytes for the log - they're written out later, by annealLogService(). If both blocks 
+ * are full, which only happens if loop() stalls for a good while, we wait out the pacing and 
+ * write a block here rather than lose data.
+ */
+static void annealLogQueue(const uint8_t *data, uint8_t length) {
+  while (length--) {
+    if (logFillLength == LOG_BLOCK_SIZE) {
+      if (logDrainLength) {
+        while ((halMillis() - logLastWriteMillis) < LOG_PACE_MS) ;
+        annealLogSendBlock();
+      }
+      annealLogSwap();
+    }
+    logBlock[logFillBlock][logFillLength++] = *data++;
+  }
+}
+
+// queue one line of text, and its newline
+void annealLogWrite(const char *s) {
+  annealLogQueue((const uint8_t *) s, strlen(s));
+  annealLogQueue((const uint8_t *) "\n", 1);
+}
+
+
+static uint8_t *annealLogPut16(uint8_t *p, uint16_t value) {
+  *p++ = value & 0xFF;
+  *p++ = value >> 8;
+  return p;
+}
+
+/*
+ * annealLogRunStart
+ * 
+ * Mark the start of a case - everything logged until annealLogRunEnd() belongs to it.
+ */
+void annealLogRunStart(uint16_t cycle) {
+  logCycle = cycle;
+  logLastTimestamp = 0;
+  logLastAmps = 0;
+  logLastVolts = 0;
+
+  #ifndef LOG_FORMAT_CSV
+  uint8_t record[LOG_RUN_START_LENGTH];
+  record[0] = LOG_TAG_RUN_START;
+  annealLogPut16(&record[1], cycle);
+  annealLogQueue(record, LOG_RUN_START_LENGTH);
+  #endif
+}
+
+/*
+ * annealLogSample
+ * 
+ * Log one data point - timestamp in milliseconds since the start of the case, amps and volts in
+ * hundredths. In the binary format, that's a 3 byte delta from the previous sample whenever it
+ * fits, and a full 7 byte record when it doesn't.
+ */
+void annealLogSample(uint16_t timestamp, uint16_t amps, uint16_t volts) {
+  #ifdef LOG_FORMAT_CSV
+  char line[LOG_LINE_LENGTH];
+  char *p;
+
+  p = formatUnsigned(line, logCycle);
+  *p++ = ',';
+  p = formatUnsigned(p, timestamp);
+  *p++ = ',';
+  p = formatScaled<5,2>(p, amps) + 5;
+  *p++ = ',';
+  formatScaled<5,2>(p, volts);
+  annealLogWrite(line);
+  #else
+  uint8_t record[LOG_ABSOLUTE_LENGTH];
+  long dt = (long) timestamp - logLastTimestamp;
+  long da = (long) amps - logLastAmps;
+  long dv = (long) volts - logLastVolts;
+
+  if ((dt >= 0) && (dt <= LOG_DELTA_MAX_MS) && (da >= -128) && (da <= 127) && (dv >= -128) && (dv <= 127)) {
+    record[0] = dt;
+    record[1] = (uint8_t) (int8_t) da;
+    record[2] = (uint8_t) (int8_t) dv;
+    annealLogQueue(record, LOG_DELTA_LENGTH);
+  }
+  else {
+    uint8_t *p = record;
+    *p++ = LOG_TAG_ABSOLUTE;
+    p = annealLogPut16(p, timestamp);
+    p = annealLogPut16(p, amps);
+    annealLogPut16(p, volts);
+    annealLogQueue(record, LOG_ABSOLUTE_LENGTH);
+  }
+  #endif
+
+  logLastTimestamp = timestamp;
+  logLastAmps = amps;
+  logLastVolts = volts;
+}
+
+/*
+ * annealLogRunEnd
+ * 
+ * Close out a case with a trailer - how many samples it had, and the timing recommendation, in
+ * hundredths of a second. The CSV version marks the line with a '#' so graphing tools skip it
+ * as a comment.
+ */
+void annealLogRunEnd(uint16_t samples, uint16_t recommendation) {
+  #ifdef LOG_FORMAT_CSV
+  char line[LOG_LINE_LENGTH];
+  char *p;
+
+  line[0] = '#';
+  p = formatUnsigned(&line[1], logCycle);
+  *p++ = ',';
+  p = formatUnsigned(p, samples);
+  *p++ = ',';
+  formatScaled<5,2>(p, recommendation);
+  annealLogWrite(line);
+  #else
+  uint8_t record[LOG_TRAILER_LENGTH];
+  uint8_t *p = record;
+  *p++ = LOG_TAG_TRAILER;
+  p = annealLogPut16(p, logCycle);
+  p = annealLogPut16(p, samples);
+  annealLogPut16(p, recommendation);
+  annealLogQueue(record, LOG_TRAILER_LENGTH);
+  #endif
+}
+
+
+/*
+ * annealLogOpenText
+ * 
+ * Switch the OpenLog over to one of the fixed name text files - the batch summaries, the dwell
+ * dumps - and append to it. Anything still queued for the old file goes out first. Any Mayan
+ * file that was open is done with by the time we get here, so there's nothing to go back to.
+ * newFile is set if the file wasn't on the card yet. Returns false if we can't open it.
+ */
+boolean annealLogOpenText(const char *fileName, boolean &newFile) {
+  String name = fileName;
+
+  annealLogFlush();
+  newFile = (annealLog.size(name) < 0);
+
+  if (! annealLog.append(name)) {
+    #ifdef DEBUG
+    Serial.print(F("DEBUG: LOG: append of "));
+    Serial.print(name);
+    Serial.println(F(" returned false"));
+    #endif
+    return false;
+  }
+  return true;
+}
+
+/*
+ * annealLogBatch
+ * 
+ * Add a line to the batch summary file (AnnealBatch.cpp) - it's plain text whatever the log
+ * format, and every batch goes in the same file, so it starts with a column header when it's
+ * new.
+ */
+void annealLogBatch(const char *line) {
+  boolean newFile;
+
+  if (! annealLogOpenText(BATCH_LOG_FILE, newFile)) return;
+
+  if (newFile) {
+    annealLogWrite("target,cases,seconds,cases/h,cycle,anneal,delay,trapdoor");
+  }
+  annealLogWrite(line);
+  annealLogFlush();
+}
+
+
+/*
+ * annealLogPrint
+ * 
+ * A Print that queues into the log, so anything with a print(Print &) - histogramPrint(), say -
+ * can write to the card the same paced way the samples do.
+ */
+class AnnealLogPrint : public Print {
+public:
+  size_t write(uint8_t c) {
+    annealLogQueue(&c, 1);
+    return 1;
+  }
+  using Print::write;
+};
+
+AnnealLogPrint annealLogPrinter;
+
+Print &annealLogPrint(void) {
+  return annealLogPrinter;
+}
+
+
+/*
+ * annealLogService
+ * 
+ * The SCHED_LOG job - runs every LOG_PACE_MS, and sends at most one block per LOG_PACE_MS. A
+ * partly full block goes out too, if there's nothing else waiting, so the log never lags more
+ * than a block or two behind.
+ */
+void annealLogService(void) {
+  if ((halMillis() - logLastWriteMillis) < LOG_PACE_MS) return;
+
+  if (!logDrainLength && logFillLength) {
+    annealLogSwap();
+  }
+  if (logDrainLength) {
+    annealLogSendBlock();
+  }
+}
+
+
+/*
+ * annealLogFlush
+ * 
+ * Write out everything that's queued, and have the OpenLog commit it to the card. This one 
+ * blocks, but by the time it's called there's rarely more than a block or two left.
+ */
+void annealLogFlush(void) {
+  while (logDrainLength || logFillLength) {
+    while ((halMillis() - logLastWriteMillis) < LOG_PACE_MS) ;
+    annealLogService();
+  }
+  annealLog.syncFile();
 }
@@ -0,0 +1,54 @@
+/**************************************************************************************************
+ *
+ * AnnealLogFormat.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Layout of the binary log files AnnealLog.cpp writes to the OpenLog. This header is shared with
+ * the decoder in extras/AnnealLogDecode, so keep it plain C - no Arduino includes.
+ *
+ * All multi-byte values are little endian. Amps and volts are in hundredths, timestamps in
+ * milliseconds since the start of the case.
+ *
+ * File header (6 bytes)
+ *   'A' 'N' 'L' 'G' <version> <reserved, 0>
+ *
+ * Then any number of records, each starting with a tag byte:
+ *
+ *   0x00-0xFC  delta sample (3 bytes) - the tag byte itself is milliseconds since the previous
+ *              sample, followed by signed 8-bit changes in amps and volts
+ *   0xFD       trailer (7 bytes) - cycle, sample count, recommendation (hundredths of a second),
+ *              each 16 bits
+ *   0xFE       run start (3 bytes) - 16-bit cycle number. The first sample after this is
+ *              relative to 0ms, 0A, 0V
+ *   0xFF       absolute sample (7 bytes) - 16-bit timestamp, amps, volts. Written whenever a
+ *              delta won't fit
+ *
+ * At CYCLE_INTERVAL, nearly every sample after the first few is a delta - 3 bytes, against the
+ * 20-some of a CSV line.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_LOG_FORMAT_H
+#define _ANNEAL_LOG_FORMAT_H
+
+#define LOG_MAGIC_0             'A'
+#define LOG_MAGIC_1             'N'
+#define LOG_MAGIC_2             'L'
+#define LOG_MAGIC_3             'G'
+#define LOG_FORMAT_VERSION      1
+
+#define LOG_HEADER_LENGTH       6
+
+#define LOG_DELTA_MAX_MS        0xFC
+#define LOG_TAG_TRAILER         0xFD
+#define LOG_TAG_RUN_START       0xFE
+#define LOG_TAG_ABSOLUTE        0xFF
+
+#define LOG_DELTA_LENGTH        3
+#define LOG_TRAILER_LENGTH      7
+#define LOG_RUN_START_LENGTH    3
+#define LOG_ABSOLUTE_LENGTH     7
+
+#endif // _ANNEAL_LOG_FORMAT_H
@@ -65,12 +65,14 @@ result useTarget(eventMask e, navNode& nav) {
   storedCases[n]=target;
   eepromStoreCase(n);
   annealSetPoint = target.time;
+  annealEnergySetPoint = target.energy;
   return(quit);
 }
 
 result saveCurrentTimeTarget(eventMask e, navNode& nav) {
   idx_t n=nav.root->path[nav.root->level-1].sel;
   storedCases[n].time = annealSetPoint;
+  storedCases[n].energy = annealEnergySetPoint;
   eepromStoreCase(n);
   return(quit);
 }
@@ -93,6 +95,16 @@ result saveUseSD(eventMask e, navNode& nav) {
   return(proceed);
 }
 
+result dumpDwell(eventMask e, navNode& nav) {
+  annealDwellDump();
+  return(proceed);
+}
+
+result showLoopProfile(eventMask e, navNode& nav) {
+  loopProfileShow();
+  return(proceed);
+}
+
 struct TargetMenu:UserMenu {
   using UserMenu::UserMenu;
 
@@ -115,9 +127,15 @@ TOGGLE(mayanUseSD, mayanUseSDToggle, "Mayan Use SD", doNothing, noEvent, wrapSty
   VALUE("False", false, saveUseSD, updateEvent)
 );
 
+TOGGLE(delayGovernor, delayGovernorToggle, "Delay Governor", doNothing, noEvent, wrapStyle,
+  VALUE(" On", true, doNothing, noEvent),
+  VALUE("Off", false, doNothing, noEvent)
+);
+
 MENU(targetEdit, "Case Edit", doNothing, noEvent, wrapStyle,
   EDIT("Name", target.name, alphaNumMask, doNothing, noEvent, noStyle),
   FIELD(target.time, "Time", "", 0.0, 200.0, 0.1, 0.01, doNothing, noEvent, noStyle),
+  FIELD(target.energy, "Energy", "J", 0.0, ANNEAL_ENERGY_MAX, 100.0, 1.0, doNothing, noEvent, noStyle),
   OP("Copy Mayan Rec", copyMayan, enterEvent),
   OP("Use", useTarget, enterEvent),
   OP("Save", saveTarget, enterEvent),
@@ -127,17 +145,54 @@ MENU(targetEdit, "Case Edit", doNothing, noEvent, wrapStyle,
 
 MENU(annealerSettingsMenu, "Annealer Settings", doNothing, anyEvent, noStyle,
   FIELD(annealSetPoint, "Anneal Time", "sec", 0.0, 20.0, .10, 0.01, doNothing, noEvent, noStyle),
+  FIELD(annealEnergySetPoint, "Anneal Enrg", "J", 0.0, ANNEAL_ENERGY_MAX, 100.0, 1.0, doNothing, noEvent, noStyle),
   FIELD(delaySetPoint, "Delay Time ", "sec", 0.0, 20.0, .10, 0.01, doNothing, noEvent, noStyle),
   FIELD(caseDropSetPoint, "Trapdoor   ", "sec", 0.5, 2.0, .10, 0.01, doNothing, noEvent, noStyle),
+  FIELD(batchSize, "Batch Size ", "", 0, BATCH_SIZE_MAX, 10, 1, doNothing, noEvent, noStyle),
+  SUBMENU(delayGovernorToggle),
+  FIELD(delayCeiling, "Temp Ceiling", " F", DELAY_CEILING_MIN, DELAY_CEILING_MAX, 10, 1, doNothing, noEvent, noStyle),
   SUBMENU(startOnOptoToggle),
   EXIT("<< Back")
 );
 
+CHOOSE(loopProfileSel, loopStateChoose, "State", doNothing, noEvent, wrapStyle,
+  VALUE("Press Start", WAIT_BUTTON, showLoopProfile, anyEvent),
+  VALUE("Wait Case", WAIT_CASE, showLoopProfile, anyEvent),
+  VALUE("Start Anneal", START_ANNEAL, showLoopProfile, anyEvent),
+  VALUE("Annealing", ANNEAL_TIMER, showLoopProfile, anyEvent),
+  VALUE("Drop Case", DROP_CASE, showLoopProfile, anyEvent),
+  VALUE("Drop Timer", DROP_CASE_TIMER, showLoopProfile, anyEvent),
+  VALUE("Delay", DELAY, showLoopProfile, anyEvent),
+  VALUE("Menu", LOOP_PROFILE_MENU, showLoopProfile, anyEvent),
+  VALUE("Mayan", LOOP_PROFILE_MAYAN, showLoopProfile, anyEvent)
+);
+
+MENU(loopTimesMenu, "Loop Times", showLoopProfile, enterEvent, noStyle,
+  SUBMENU(loopStateChoose),
+  FIELD(loopMinMs, "Min ", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(loopMeanMs, "Mean", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(loopP99Ms, "p99 ", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(loopMaxMs, "Max ", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  EXIT("<< Back")
+);
+
 MENU(dataDisplayMenu, "Data Display", doNothing, anyEvent, noStyle,
   FIELD(Therm1TempHigh, "T1 High", " F", 0.0, 200.0, 0.1, 0.001, doNothing, noEvent, noStyle),
   #ifdef _AP3_VARIANT_H_
   FIELD(internalTempHigh, "Int High", " F", 0.0, 200.0, 0.1, 0.001, doNothing, noEvent, noStyle),
   #endif
+  FIELD(annealLateP50, "Late p50", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealLateP99, "Late p99", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealLateMax, "Late max", "ms", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealEnergyLast, "Energy", "J", 0.0, ANNEAL_ENERGY_MAX, 100.0, 1.0, doNothing, noEvent, noStyle),
+  #ifdef ANNEAL_STATS
+  FIELD(annealDwellP50[WAIT_CASE], "Wait p50", "s", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealDwellP50[ANNEAL_TIMER], "Anneal p50", "s", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealDwellP50[DROP_CASE_TIMER], "Drop p50", "s", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  FIELD(annealDwellP50[DELAY], "Delay p50", "s", 0.0, 1000.0, 1.0, 0.1, doNothing, noEvent, noStyle),
+  OP("Dump Dwell", dumpDwell, enterEvent),
+  #endif
+  SUBMENU(loopTimesMenu),
   EXIT("<< Back")
 );
 
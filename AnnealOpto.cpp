@@ -0,0 +1,193 @@
+/**************************************************************************************************
+ *
+ * AnnealOpto.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Case detect opto sensors. Each sensor pin gets a pin change interrupt (halPinChangeBegin), and
+ * the interrupt does nothing but stamp the edge with halMillis() and queue it. optoUpdate() drains
+ * the queue from annealStateMachine(), every pass, and keeps track of each sensor:
+ *
+ * - whether it sees a case right now
+ * - when the case it sees showed up - the time of the edge, not of whatever pass of loop()
+ *   happened to notice it, so the OPTO_DELAY debounce is measured from when the case actually
+ *   got there, even if loop() was off updating the screen
+ * - how many cases have shown up, so the state machine can tell a new case from the one that's
+ *   been sitting there since before the trap door opened
+ *
+ * A dropout shorter than OPTO_GLITCH_MS doesn't count as the case leaving - the arrival time
+ * stands, and it's not a new case. Anything longer, and it is.
+ *
+ * The queue is single producer (the interrupt), single consumer (loop()), same as the sampler's
+ * ring. If it ever fills, we've lost edges, so after draining what's there we go by what the
+ * pins read now. Pins that can't interrupt on this board fall back to polling from optoUpdate().
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+
+#define OPTO_QUEUE_MASK   (OPTO_QUEUE_SIZE - 1)
+static_assert((OPTO_QUEUE_SIZE & OPTO_QUEUE_MASK) == 0, "OPTO_QUEUE_SIZE must be a power of two");
+
+// keeps the compiler from moving the edge copy past the index update
+#define OPTO_BARRIER()    __asm__ __volatile__("" ::: "memory")
+
+struct OptoEdge {
+  unsigned long timestamp;
+  uint8_t sensor;
+  boolean present;
+};
+
+#ifdef OPTO2_PIN
+static const uint8_t optoPins[OPTO_SENSORS] = { OPTO1_PIN, OPTO2_PIN };
+#else
+static const uint8_t optoPins[OPTO_SENSORS] = { OPTO1_PIN };
+#endif
+
+OptoEdge optoQueue[OPTO_QUEUE_SIZE];
+volatile uint8_t optoHead = 0;            // next slot the interrupt fills
+volatile uint8_t optoTail = 0;            // next slot loop() reads
+volatile boolean optoOverrun = false;
+volatile boolean optoLevel[OPTO_SENSORS]; // what the interrupt last saw - true for a case
+
+boolean optoPolled = false;               // some pin can't interrupt - optoUpdate() polls for us
+
+// what loop() knows, from the edges so far
+boolean optoCase[OPTO_SENSORS];
+unsigned long optoSince[OPTO_SENSORS];    // when the current case showed up
+unsigned long optoGoneAt[OPTO_SENSORS];   // when the last case went away
+boolean optoGone[OPTO_SENSORS];           // optoGoneAt is good - there was a case, and it left
+uint16_t optoArrivalCount[OPTO_SENSORS];
+
+
+/*
+ * optoEdges
+ *
+ * The pin change interrupt - queue up any sensor that's changed. On an AVR, this can be called
+ * for a change on some other pin on the same port, so it can't assume anything changed at all.
+ */
+static void optoEdges(void) {
+  uint8_t i, next;
+  boolean present;
+
+  for (i = 0; i < OPTO_SENSORS; i++) {
+    present = halCasePresent(i);
+    if (present == optoLevel[i]) continue;
+
+    next = (optoHead + 1) & OPTO_QUEUE_MASK;
+    if (next == optoTail) {
+      optoOverrun = true;   // leave optoLevel alone - optoUpdate() picks this one up from the pin
+      continue;
+    }
+
+    optoLevel[i] = present;
+    optoQueue[optoHead].timestamp = halMillis();
+    optoQueue[optoHead].sensor = i;
+    optoQueue[optoHead].present = present;
+    OPTO_BARRIER();
+    optoHead = next;
+  }
+}
+
+// one edge, in order
+static void optoApply(uint8_t sensor, boolean present, unsigned long timestamp) {
+  if (present == optoCase[sensor]) return;
+
+  optoCase[sensor] = present;
+
+  if (!present) {
+    optoGoneAt[sensor] = timestamp;
+    optoGone[sensor] = true;
+  }
+  else if (!optoGone[sensor] || ((timestamp - optoGoneAt[sensor]) >= OPTO_GLITCH_MS)) {
+    optoSince[sensor] = timestamp;
+    optoArrivalCount[sensor]++;
+  }
+  // else it's the same case, back from a glitch - optoSince stands
+}
+
+
+/*
+ * optoBegin
+ *
+ * Start watching the sensors - called once from setup(), after halBegin(). Whatever's in front
+ * of them already counts as having been there since now.
+ */
+void optoBegin(void) {
+  uint8_t i;
+  unsigned long now = halMillis();
+
+  for (i = 0; i < OPTO_SENSORS; i++) {
+    optoLevel[i] = halCasePresent(i);
+    optoCase[i] = optoLevel[i];
+    optoSince[i] = now;
+    optoGone[i] = false;
+    optoArrivalCount[i] = 0;
+  }
+
+  for (i = 0; i < OPTO_SENSORS; i++) {
+    if (!halPinChangeBegin(optoPins[i], optoEdges)) optoPolled = true;
+  }
+
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: OPTO: "));
+  Serial.println(optoPolled ? F("no pin change interrupt, polling") : F("pin change interrupt"));
+  #endif
+}
+
+/*
+ * optoUpdate
+ *
+ * Catch up on the edges the interrupt queued - called every pass of annealStateMachine()
+ */
+void optoUpdate(void) {
+  uint8_t tail = optoTail;
+  uint8_t i;
+  OptoEdge edge;
+
+  if (optoPolled) {
+    noInterrupts();   // the other sensor might still have its interrupt
+    optoEdges();
+    interrupts();
+  }
+
+  while (tail != optoHead) {
+    OPTO_BARRIER();
+    edge = optoQueue[tail];
+    OPTO_BARRIER();
+    tail = (tail + 1) & OPTO_QUEUE_MASK;
+    optoTail = tail;
+
+    optoApply(edge.sensor, edge.present, edge.timestamp);
+  }
+
+  if (optoOverrun) {
+    noInterrupts();
+    optoOverrun = false;
+    optoTail = optoHead;  // anything queued since is older than what the pins say now
+    for (i = 0; i < OPTO_SENSORS; i++) optoLevel[i] = halCasePresent(i);
+    interrupts();
+
+    for (i = 0; i < OPTO_SENSORS; i++) optoApply(i, optoLevel[i], halMillis());
+
+    #ifdef DEBUG
+    Serial.println(F("DEBUG: OPTO: edge queue overrun"));
+    #endif
+  }
+}
+
+/*
+ * optoPresent
+ *
+ * True if sensor sees a case, as of the last optoUpdate() - and since is when it showed up
+ */
+boolean optoPresent(uint8_t sensor, unsigned long &since) {
+  since = optoSince[sensor];
+  return optoCase[sensor];
+}
+
+// how many cases sensor has seen show up - it wraps, so only compare for equality
+uint16_t optoArrivals(uint8_t sensor) {
+  return optoArrivalCount[sensor];
+}
@@ -0,0 +1,211 @@
+/**************************************************************************************************
+ *
+ * AnnealSampler.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Background sensor sampler. A timer interrupt (halTickerBegin) reads the current, voltage, and
+ * thermistor pins every SAMPLER_TICK_MS, adding the raw conversions up as it goes, and every
+ * SAMPLER_TICKS ticks it closes out a SensorSample, stamps it, and drops it in a ring. The state
+ * machines pick samples up with samplerRead() (or sensorsUpdate() in Environmentals.cpp), so
+ * samples are evenly spaced no matter what loop() was busy with, and the foreground never waits
+ * on the ADC.
+ *
+ * The ring is single producer (the interrupt), single consumer (loop()) - the interrupt only
+ * ever moves samplerHead, and loop() only ever moves samplerTail, so neither side needs to lock
+ * the other out. Indexes are one byte, so reading one is atomic on AVR too. If loop() falls so
+ * far behind that the ring fills, new samples are dropped and counted in samplerOverruns.
+ *
+ * Boards without a timer for us fall back to ticking from samplerRead(), which is only as
+ * regular as loop() is - same as before we had the sampler.
+ *
+ * Energy: while the inductor is on, every tick also adds that tick's volts times amps to a 
+ * running total, and if there's an energy limit armed, the tick that crosses it switches the
+ * inductor off right there in the interrupt. At SAMPLER_TICK_MS, that's a 100Hz rectangle rule
+ * - current and voltage change over seconds, not milliseconds, so over a several second anneal
+ * the integration error is well under a percent, and the cutoff lands within one tick (a
+ * quarter of a percent of a 4 second anneal) of the target. The math is all integer, in raw
+ * ADC units - ENERGY_JOULES_PER_UNIT turns that into joules, with the same conversions
+ * ampsFromCounts() and voltsFromCounts() use.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+
+#define SAMPLER_RING_MASK   (SAMPLER_RING_SIZE - 1)
+static_assert((SAMPLER_RING_SIZE & SAMPLER_RING_MASK) == 0, "SAMPLER_RING_SIZE must be a power of two");
+
+// keeps the compiler from moving the sample copy past the index update
+#define SAMPLER_BARRIER()   __asm__ __volatile__("" ::: "memory")
+
+SensorSample samplerRing[SAMPLER_RING_SIZE];
+volatile uint8_t samplerHead = 0;         // next slot the interrupt fills
+volatile uint8_t samplerTail = 0;         // next slot loop() reads
+volatile unsigned int samplerOverruns = 0;
+
+// current sense reads AMPS_ZERO_VOLTS at zero amps, and AMPS_PER_VOLT past that - as a tick's
+// oversampled reading
+#define ENERGY_AMPS_ZERO        ((uint32_t) (((float) RESOLUTION_MAX * POWER_TICK_SCALE * AMPS_ZERO_VOLTS / VREF) + 0.5))
+#define ENERGY_JOULES_PER_UNIT  (((VREF / RESOLUTION_MAX) * AMPS_PER_VOLT) * VOLTS_PER_RESOLUTION * (SAMPLER_TICK_MS / 1000.0) / (POWER_TICK_SCALE * POWER_TICK_SCALE))
+
+volatile boolean samplerEnergyArmed = false;
+volatile uint64_t samplerEnergy = 0;      // ENERGY_JOULES_PER_UNIT
+uint64_t samplerEnergyLimit = 0;          // 0 - just measure, no cutoff
+
+// the sample being built up - only touched by the interrupt, or with it held off
+uint32_t samplerAmps = 0;
+uint32_t samplerVolts = 0;
+uint32_t samplerTherm1 = 0;
+uint8_t samplerTickCount = 0;
+
+boolean samplerPolled = false;            // no timer - samplerRead() ticks for us
+unsigned long samplerLastTick = 0;
+
+
+/*
+ * samplerTick
+ *
+ * One tick - current and voltage oversampled by POWER_OVERSAMPLE_BITS, and SAMPLER_READS
+ * conversions of the thermistor, each after the one the HAL throws away to settle when it
+ * switches pins (see halAnalogRead). That's SAMPLER_TICK_CONVERSIONS, 13 conversions, about 1.5ms
+ * on a 16MHz AVR out of every 10ms tick, or 130us on the Artemis - and on an AVR, the cutoff
+ * waits that long if it comes due in the middle of one. Every SAMPLER_TICKS, the sums go in the
+ * ring as a sample.
+ */
+static void samplerTick(void) {
+  uint8_t i, next;
+  uint32_t tickAmps = halAnalogReadOversampledISR(CURRENT_PIN, POWER_OVERSAMPLE_BITS);
+  uint32_t tickVolts = halAnalogReadOversampledISR(VOLTAGE_PIN, POWER_OVERSAMPLE_BITS);
+
+  samplerAmps += tickAmps;
+  samplerVolts += tickVolts;
+
+  if (samplerEnergyArmed) {
+    if (halInductorExpired()) {
+      samplerEnergyArmed = false;     // off by time, or by hand - we're done counting
+    }
+    else {
+      if (tickAmps > ENERGY_AMPS_ZERO) {
+        samplerEnergy += (uint64_t) (tickAmps - ENERGY_AMPS_ZERO) * tickVolts;
+      }
+      if (samplerEnergyLimit && (samplerEnergy >= samplerEnergyLimit)) {
+        halInductorCutoff();
+        samplerEnergyArmed = false;
+      }
+    }
+  }
+
+  for (i = 0; i < SAMPLER_READS; i++) samplerTherm1 += halAnalogReadISR(THERM1_PIN);
+
+  if (++samplerTickCount < SAMPLER_TICKS) return;
+
+  next = (samplerHead + 1) & SAMPLER_RING_MASK;
+  if (next == samplerTail) {
+    samplerOverruns++;
+  }
+  else {
+    SensorSample *s = &samplerRing[samplerHead];
+    s->timestamp = halMillis();
+    s->amps = samplerAmps;
+    s->volts = samplerVolts;
+    s->therm1 = samplerTherm1;
+    SAMPLER_BARRIER();
+    samplerHead = next;
+  }
+
+  samplerAmps = 0;
+  samplerVolts = 0;
+  samplerTherm1 = 0;
+  samplerTickCount = 0;
+}
+
+
+/*
+ * samplerBegin
+ *
+ * Start sampling - called once from setup(), after halBegin()
+ */
+void samplerBegin(void) {
+  samplerReset();
+  samplerPolled = !halTickerBegin(SAMPLER_TICK_MS, samplerTick);
+  samplerLastTick = halMillis();
+
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: SAMPLER: "));
+  Serial.println(samplerPolled ? F("no timer, polling") : F("timer running"));
+  #endif
+}
+
+/*
+ * samplerReset
+ *
+ * Throw away anything queued, and start the next sample from scratch - so the first sample
+ * after this covers only what happened after this.
+ */
+void samplerReset(void) {
+  noInterrupts();
+  samplerTail = samplerHead;
+  samplerAmps = 0;
+  samplerVolts = 0;
+  samplerTherm1 = 0;
+  samplerTickCount = 0;
+  interrupts();
+}
+
+/*
+ * samplerEnergyArm
+ *
+ * Start counting energy from zero, for an anneal that's about to start - and cut the inductor
+ * off at joules, if that's more than 0. Call it just after the inductor goes on - a tick that
+ * finds the inductor off stops the count.
+ */
+void samplerEnergyArm(float joules) {
+  uint64_t limit = (joules > 0) ? (uint64_t) ((joules / ENERGY_JOULES_PER_UNIT) + 0.5) : 0;
+
+  noInterrupts();
+  samplerEnergy = 0;
+  samplerEnergyLimit = limit;
+  samplerEnergyArmed = true;
+  interrupts();
+}
+
+// joules counted since samplerEnergyArm()
+float samplerEnergyJoules(void) {
+  uint64_t energy;
+
+  noInterrupts();
+  energy = samplerEnergy;
+  interrupts();
+
+  return energy * ENERGY_JOULES_PER_UNIT;
+}
+
+/*
+ * samplerRead
+ *
+ * Take the oldest sample off the ring. Returns false if there isn't one yet.
+ */
+boolean samplerRead(SensorSample &sample) {
+  uint8_t tail = samplerTail;
+
+  if (samplerPolled) {
+    // catch up on missed ticks, but if loop() was gone for a long while, just start over
+    if ((halMillis() - samplerLastTick) > (SAMPLER_PERIOD_MS * 2)) {
+      samplerLastTick = halMillis() - SAMPLER_TICK_MS;
+    }
+    while ((halMillis() - samplerLastTick) >= SAMPLER_TICK_MS) {
+      samplerLastTick += SAMPLER_TICK_MS;
+      samplerTick();
+    }
+  }
+
+  if (tail == samplerHead) return false;
+
+  SAMPLER_BARRIER();
+  sample = samplerRing[tail];
+  SAMPLER_BARRIER();
+  samplerTail = (tail + 1) & SAMPLER_RING_MASK;
+
+  return true;
+}
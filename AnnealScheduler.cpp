@@ -0,0 +1,141 @@
+/**************************************************************************************************
+ *
+ * AnnealScheduler.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Cooperative scheduler for the periodic jobs - thermistors, LCD refresh, the anneal readouts,
+ * and draining the OpenLog queue. Each job is registered once from setup() with a period and
+ * a priority, instead of every subsystem polling a Chrono of its own on every pass of loop().
+ *
+ * Each pass, schedRun() runs at most one job - of the ones that are due, the highest priority
+ * (lowest number) goes first, and between equals, the one that's been waiting longest. A job's
+ * next deadline is one period after its last one, so it doesn't drift with loop() timing. If a
+ * job falls more than a whole period behind, it skips ahead rather than running several times
+ * in a row to catch up.
+ *
+ * The state machines still run every pass - they react to interrupts (buttons, the opto edges,
+ * the inductor cutoff, the sampler) rather than to time. When they're waiting on a Chrono
+ * instead, schedTimerPassed() tells us how long they have left.
+ *
+ * Between passes, schedIdle() puts the CPU to sleep until the next interrupt, as long as the
+ * nearest deadline is at least SCHED_SLEEP_MIN_MS away and the LCD has nothing left to send.
+ * The sampler's ticker interrupt wakes us at least that often, so nothing ever sleeps through
+ * its deadline - and inside SCHED_SLEEP_MIN_MS of one, we just keep polling, so deadlines land
+ * as close as they always did.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+#include <Chrono.h>
+
+struct SchedJobEntry {
+  void (*run)(void);          // NULL until registered
+  unsigned long period;
+  unsigned long due;          // halMillis() of the next run
+  uint8_t priority;
+};
+
+SchedJobEntry schedJobs[SCHED_JOBS];
+unsigned long schedWakeMillis = 0;    // the earliest schedTimerPassed() wait, this pass
+boolean schedWakeSet = false;
+
+
+/*
+ * schedRegister
+ *
+ * Run job every period milliseconds, starting one period from now. Lower priority numbers go
+ * first when more than one job is due.
+ */
+void schedRegister(SchedJob job, unsigned long period, uint8_t priority, void (*run)(void)) {
+  schedJobs[job].run = run;
+  schedJobs[job].period = period;
+  schedJobs[job].priority = priority;
+  schedJobs[job].due = halMillis() + period;
+}
+
+/*
+ * schedRestart
+ *
+ * Start job's period over from now - the same as restarting the Chrono it replaced
+ */
+void schedRestart(SchedJob job) {
+  schedJobs[job].due = halMillis() + schedJobs[job].period;
+}
+
+/*
+ * schedRun
+ *
+ * Run the job that's up next, if any are due. Returns true if one ran.
+ */
+boolean schedRun(void) {
+  unsigned long now = halMillis();
+  SchedJobEntry *next = NULL;
+
+  for (uint8_t i = 0; i < SCHED_JOBS; i++) {
+    SchedJobEntry *j = &schedJobs[i];
+
+    if (!j->run || ((long) (now - j->due) < 0)) continue;
+
+    if (!next || (j->priority < next->priority) ||
+        ((j->priority == next->priority) && ((long) (j->due - next->due) < 0))) {
+      next = j;
+    }
+  }
+
+  if (!next) return false;
+
+  next->due += next->period;
+  if ((long) (now - next->due) >= 0) {   // a whole period behind - don't try to catch up
+    next->due = now + next->period;
+  }
+  next->run();
+
+  return true;
+}
+
+/*
+ * schedTimerPassed
+ *
+ * timer.hasPassed(ms) - and if it hasn't, make sure schedIdle() doesn't sleep past the moment
+ * it does. For the state machines' one-shot waits.
+ */
+boolean schedTimerPassed(Chrono &timer, unsigned long ms) {
+  unsigned long wake;
+
+  if (timer.hasPassed(ms)) return true;
+
+  wake = halMillis() + (ms - timer.elapsed());
+  if (!schedWakeSet || ((long) (wake - schedWakeMillis) < 0)) {
+    schedWakeMillis = wake;
+    schedWakeSet = true;
+  }
+  return false;
+}
+
+/*
+ * schedIdle
+ *
+ * Called at the end of each pass of loop(), outside the menu system - sleep until the next
+ * interrupt if there's nothing to do for a while.
+ */
+void schedIdle(void) {
+  unsigned long now = halMillis();
+  long left = SCHED_SLEEP_MIN_MS;
+
+  if (schedWakeSet) {
+    left = (long) (schedWakeMillis - now);
+    schedWakeSet = false;
+  }
+
+  for (uint8_t i = 0; i < SCHED_JOBS; i++) {
+    if (schedJobs[i].run && ((long) (schedJobs[i].due - now) < left)) {
+      left = (long) (schedJobs[i].due - now);
+    }
+  }
+
+  if ((left < SCHED_SLEEP_MIN_MS) || lcdBufPending()) return;
+
+  halSleep();
+}
@@ -5,23 +5,269 @@
  * Author: Dave Re
  * Inception: 05/18/2020
  * 
- * This file contains the actual state machine that's used during the annealing cycle.
+ * This file contains the actual state machine that's used during the annealing cycle - one
+ * enter/tick/exit set per AnnealState, laid out in annealStates[] for the engine in AnnealFSM.h.
  * 
- * All of the externs below are in Annealer-Control.ino
+ * The state and settings it runs on (annealState, the set points, the button flags) are globals
+ * from Annealer-Control.ino, declared in Annealer-Control.h. What's below is only used in here.
  * 
  **************************************************************************************************/
 
 #include "Annealer-Control.h"
+#include "AnnealFSM.h"
 #include <Chrono.h>
 #include <Rencoder.h>
 
 #include <ctype.h>
 
-#ifdef DEBUG_STATE
-  boolean stateChange = true;
-#endif
+static unsigned long delayMillis = 0;   // this cycle's DELAY - from the governor, or just delaySetPoint
+static boolean caseWaitNew = false;     // the case we just annealed is still in front of the opto
+static uint16_t caseArrivalMark = 0;    // optoArrivals() as of the trap door opening
+static unsigned long caseDropDoneMillis = 0;  // when the trap door closed again
+
+
+/*
+ * annealCaseReady
+ * 
+ * Case detect debounce - true once a case has been sitting in front of the opto for OPTO_DELAY,
+ * counted from the edge that AnnealOpto.cpp caught it on. That's kept up in the background, so
+ * a case that drops into the coil while we're still cooling down has already served its
+ * OPTO_DELAY by the time DELAY runs out. The catch is that the opto still sees the case we just
+ * annealed until it falls clear of the trap door - so after DROP_CASE, only a case that shows
+ * up after that counts.
+ * 
+ * Unless the opto never got to see a gap: the next case can drop in right on the last one's
+ * heels, closer than OPTO_GLITCH_MS, or between polls where the opto pin can't interrupt. Then
+ * there's no new arrival, but there is a case - so one that's still there OPTO_DELAY after the
+ * trap door closed gets annealed, same as it would have before we tracked arrivals.
+ */
+static boolean annealCaseReady(void) {
+  unsigned long since;
+
+  if (!optoPresent(OPTO_CASE_DETECT, since)) return false;
+  if (caseWaitNew && (optoArrivals(OPTO_CASE_DETECT) == caseArrivalMark)) since = caseDropDoneMillis;
+
+  return ((halMillis() - since) >= OPTO_DELAY);
+}
+
+
+  ////////////////////////////////
+  // WAIT_BUTTON
+  //
+  // Wait for the start button.
+  // However we got here - stopped,
+  // or the batch is done - the
+  // inductor and trap door are off,
+  // and the batch gets logged
+  ////////////////////////////////
+
+static void waitButtonEnter(void) {
+  halInductor(false);
+  halSolenoid(false);
+  batchEnd(); // log however far the batch got
+}
+
+static uint8_t waitButtonTick(void) {
+  if (!startPressed) return WAIT_BUTTON;
+
+  startPressed = false;
+  return WAIT_CASE;
+}
+
+// the only way out is the start button
+static void waitButtonExit(void) {
+  batchStart();
+  governorStart();
+  caseWaitNew = false; // anything already in the coil is fair game
+}
+
+
+  ////////////////////////////////
+  // WAIT_CASE
+  //
+  // If we have an optical sensor
+  // for cases, we'll wait here for
+  // the sensor to detect a case.
+  ////////////////////////////////
+
+static void waitCaseEnter(void) {
+  if (startOnOpto) {
+    lcdBufBacklight(GREEN);
+  }
+}
+
+static uint8_t waitCaseTick(void) {
+  // only save the annealer set point if it's changed and we go to use it
+  #ifndef DEBUG_TIMING_SWEEP
+  eepromCheckAnnealSetPoint();
+  #endif
+
+  if (!startOnOpto) return START_ANNEAL; // if we're not messing w/ the opto sensor, just go to the next step
+
+  #ifdef DEBUG
+    Serial.print(F("DEBUG: OPTO1_PIN case present: ")); Serial.println(halCasePresent());
+  #endif
+
+  // there's a case waiting, and it's been there OPTO_DELAY
+  return annealCaseReady() ? START_ANNEAL : WAIT_CASE;
+}
+
+
+  ////////////////////////////////
+  // START_ANNEAL
+  //
+  // Start the annealing process
+  // and timer
+  // 
+  // The inductor cutoff is armed
+  // in hardware, so it lands on
+  // time even if the loop is busy.
+  // With an energy set point, the
+  // sampler can cut it off sooner
+  // 
+  // This is a single cycle state
+  ////////////////////////////////
+
+static void startAnnealEnter(void) {
+  lcdBufBacklight(RED);
+  halInductorArm((unsigned long) floor((annealSetPoint * 1000.0) + 0.5));
+  samplerEnergyArm(annealEnergySetPoint); // measure always, and cut off there if it's set
+  Timer.restart(); 
+  schedRestart(SCHED_ANNEAL_POWER);
+  schedRestart(SCHED_ANNEAL_TIMER);
+}
+
+static uint8_t startAnnealTick(void) {
+  return ANNEAL_TIMER;
+}
+
+
+  ////////////////////////////////
+  // ANNEAL_TIMER
+  //
+  // Wait for the armed cutoff to
+  // switch the inductor off. The
+  // cutoff doesn't depend on us, so
+  // the SCHED_ANNEAL_TIMER and
+  // SCHED_ANNEAL_POWER jobs can keep
+  // the LCD up all the way to the end
+  ////////////////////////////////
+
+static uint8_t annealTimerTick(void) {
+  if (!halInductorExpired()) return ANNEAL_TIMER;
+
+  // lateness only means something when time made the call
+  annealEnergyLast = samplerEnergyJoules();
+  if (annealEnergySetPoint <= 0.0) {
+    annealRecordLateness(halInductorOnTime());
+  }
+  
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: anneal energy ")); Serial.print(annealEnergyLast); Serial.println(F(" J"));
+  #endif
+  batchCaseDone();
+
+  return DROP_CASE;
+}
+
+
+  ////////////////////////////////
+  // DROP_CASE
+  //
+  // Trigger the solenoid and start
+  // the solenoid timer. Update
+  // the display once, so Timer goes 
+  // back to 0.00 (by annealState in
+  // updateLCDTimer)
+  // 
+  // This is a single cycle state
+  ////////////////////////////////
+
+static void dropCaseEnter(void) {
+  Timer.restart();
+  lcdBufBacklight(BLUE);
+  schedRestart(SCHED_LCD);
+  halSolenoid(true);
+  caseWaitNew = true; // wait for the case we just did to fall clear, and a new one to show
+  caseArrivalMark = optoArrivals(OPTO_CASE_DETECT);
+  updateLCDTimer();
+}
+
+static uint8_t dropCaseTick(void) {
+  return DROP_CASE_TIMER;
+}
+
+
+  ////////////////////////////////
+  // DROP_CASE_TIMER
+  //
+  // Close the solenoid at the right
+  // time - and if that was the last
+  // case of a batch, no need to wait
+  // on DELAY, we're done
+  ////////////////////////////////
+
+static uint8_t dropCaseTimerTick(void) {
+  if (!schedTimerPassed(Timer, (int) caseDropSetPoint * 1000)) return DROP_CASE_TIMER;
+
+  if (batchComplete()) {
+    lcdBufBacklight(YELLOW); // yellow to show the batch is finished
+    return WAIT_BUTTON;
+  }
+  return DELAY;
+}
+
+static void dropCaseTimerExit(void) {
+  halSolenoid(false);
+  caseDropDoneMillis = halMillis();
+}
+
+
+  ////////////////////////////////
+  // DELAY
+  //
+  // Duty cycle to allow heat to 
+  // dissipate a bit - how long is
+  // up to the delay governor, if
+  // it's on
+  ////////////////////////////////
+
+static void delayEnter(void) {
+  Timer.restart();
+  delayMillis = governorDelayMillis();
+}
+
+static uint8_t delayTick(void) {
+  if (!schedTimerPassed(Timer, delayMillis)) return DELAY;
+
+  #ifdef DEBUG_TIMING_SWEEP
+  annealSetPoint += TIMING_SWEEP_STEP;
+  if (annealSetPoint > TIMING_SWEEP_MAX) annealSetPoint -= TIMING_SWEEP_MAX;
+  #endif
+
+  return WAIT_CASE;
+}
+
+
+// in AnnealState order
+static const FsmState annealStates[ANNEAL_STATES] = {
+  { FSM_NAME("WAIT_BUTTON"),     waitButtonEnter,  waitButtonTick,    waitButtonExit    },
+  { FSM_NAME("WAIT_CASE"),       waitCaseEnter,    waitCaseTick,      NULL              },
+  { FSM_NAME("START_ANNEAL"),    startAnnealEnter, startAnnealTick,   NULL              },
+  { FSM_NAME("ANNEAL_TIMER"),    NULL,             annealTimerTick,   NULL              },
+  { FSM_NAME("DROP_CASE"),       dropCaseEnter,    dropCaseTick,      NULL              },
+  { FSM_NAME("DROP_CASE_TIMER"), NULL,             dropCaseTimerTick, dropCaseTimerExit },
+  { FSM_NAME("DELAY"),           delayEnter,       delayTick,         NULL              }
+};
+
+// every transition - the dwell histograms, and the State line on the LCD
+static void annealStateChanged(void) {
+  annealDwellTrack();
+  updateLCDState();
+}
+
+static StateMachine<AnnealState, ANNEAL_STATES> annealFsm(annealStates, annealState, annealStateChanged);
 
-boolean caseArrived = false;
 
 void annealStateMachine() {
 
@@ -36,7 +282,9 @@ void annealStateMachine() {
         nav.idleOff();
         menuState = MAIN_MENU;
         showedScreen = false;
-        lcd.setFastBacklight(WHITE);
+        batchClear();
+        lcdBufBacklight(WHITE);
+        lcdBufFlush(LCD_COST_BACKLIGHT); // just the backlight - the menu owns the screen now
         (void) encoder.clear(); // clear our flags
       }
       else { // if we're in a cycle, we'll use this click to stop the cycle safely
@@ -54,9 +302,6 @@ void annealStateMachine() {
      #ifdef DEBUG
       Serial.println(F("DEBUG: start button pressed"));
      #endif
-     #ifdef DEBUG_STATE
-      stateChange = true;
-     #endif
   
     } 
     else if (startPressed) startPressed = false;
@@ -65,20 +310,15 @@ void annealStateMachine() {
     // only take action on the Stop Button if we're actively in the anneal 
     // cycle. Treat the encoder button as a Stop Button if we're annealing, too
     if ((stopPressed || encoderPressed) && (annealState != WAIT_BUTTON)) {
-      digitalWrite(INDUCTOR_PIN, LOW);
-      digitalWrite(LED_BUILTIN, LOW);
-      digitalWrite(SOLENOID_PIN, LOW);
-      annealState = WAIT_BUTTON;
+      stopPressed = false;
       encoderPressed = false;
-      lcd.setFastBacklight(ORANGE); // orange to show abort
+      lcdBufBacklight(ORANGE); // orange to show abort
       
       #ifdef DEBUG
       Serial.println(F("DEBUG: stop button pressed - anneal cycle aborted"));
       #endif
-      #ifdef DEBUG_STATE
-      stateChange = true;
-      #endif
-  
+
+      annealFsm.go(WAIT_BUTTON); // switches everything off, and logs the batch
     }
     else if (stopPressed) stopPressed = false;
   
@@ -109,304 +349,17 @@ void annealStateMachine() {
     }
   
     
-    // Check our normal analog sensors
+    // Check our normal analog sensors - the sampler did the reading in the background, so 
+    // catching up is cheap enough to do every pass, even while annealing
     
-    if (AnalogSensors.hasPassed(ANALOG_INTERVAL, true)) {   // Note - the boolean restarts the timer for us
-  
-      // we us this section to update current and voltage while we're not actively annealing
-      if ( (annealState != START_ANNEAL) && (annealState != ANNEAL_TIMER ) ) checkPowerSensors(false);
-      
-      checkThermistors(false);
-      
-    } // if (AnalogSensors...
+    sensorsUpdate();
+    optoUpdate();
     
     
     ////////////////////////////////////////////////////////
-    // Basic state machine for the annealing cycle
+    // Then the state machine for the annealing cycle
     ////////////////////////////////////////////////////////
   
-  
-  
-    switch(annealState) {
-  
-      ////////////////////////////////
-      // WAIT_BUTTON
-      //
-      // Wait for the start button
-      // Normal sensor handling, etc
-      ////////////////////////////////
-      case WAIT_BUTTON:
-        #ifdef DEBUG_STATE
-          if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter WAIT_BUTTON")); stateChange = false; }
-        #endif
-        
-        if ( LCDTimer.hasPassed(LCD_UPDATE_INTERVAL) ) {
-          updateLCD(false);
-          LCDTimer.restart();
-        }
-        
-        if (startPressed) {
-          annealState = WAIT_CASE;
-          startPressed = false;
-          if (startOnOpto) {
-            lcd.setFastBacklight(GREEN);
-          }
-          updateLCDState();
-          
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-        }
-        break;
-  
-  
-      ////////////////////////////////
-      // WAIT_CASE
-      //
-      // If we have an optical sensor
-      // for cases, we'll wait here for
-      // the sensor to detect a case.
-      // Normal sensor handling while
-      // we wait.
-      ////////////////////////////////
-      case WAIT_CASE:
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter WAIT_CASE")); stateChange = false; }
-        #endif
-  
-        if ( LCDTimer.hasPassed(LCD_UPDATE_INTERVAL) ) {
-          updateLCD(false);
-          LCDTimer.restart();
-        }
-
-        // only save the annealer set point if it's changed and we go to use it
-        eepromCheckAnnealSetPoint();
-
-        if (startOnOpto) {
-          
-          // check the sensor
-          int opto1State = 0;
-          opto1State = digitalRead(OPTO1_PIN);
-
-          #ifdef DEBUG
-            Serial.print(F("DEBUG: OPTO1_PIN state: ")); Serial.println(opto1State);
-          #endif
-
-          if (opto1State == LOW) { // there's a case waiting if the pin is LOW
-
-            if (caseArrived && Timer.hasPassed(OPTO_DELAY)) {
-            
-              annealState = START_ANNEAL;
-              lcd.setFastBacklight(RED);
-              updateLCDState();
-              
-              #ifdef DEBUG_STATE
-              stateChange = true;
-              #endif
-              
-            }
-            else if (! caseArrived) {
-              
-              Timer.restart();
-              caseArrived = true;
-              
-            }
-            // otherwise we're waiting on the timer to expire
-            
-          } 
-          else {
-
-            if (caseArrived && Timer.hasPassed(OPTO_DELAY)) { // if we waited OPTO_DELAY, but the case is no longer there...
-              caseArrived = false;
-            }
-            
-          }
-          
-        }
-        else { // if we're not messing w/ the opto sensor, just go to the next step
-          annealState = START_ANNEAL;
-          lcd.setFastBacklight(RED);
-          updateLCDState();
-          
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-        }
-        break;
-  
-  
-      ////////////////////////////////
-      // START_ANNEAL
-      //
-      // Initial state change to start
-      // the annealing process and timer
-      // 
-      // This is a single cycle state,
-      // so we don't need to update
-      // any sensors or the display
-      ////////////////////////////////
-  
-      case START_ANNEAL:
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter START_ANNEAL")); stateChange = false; }
-        #endif
-        
-        annealState = ANNEAL_TIMER;
-        digitalWrite(INDUCTOR_PIN, HIGH);
-        digitalWrite(LED_BUILTIN, HIGH);
-        Timer.restart(); 
-        AnnealPowerSensors.restart();
-        AnnealLCDTimer.restart();
-  
-        #ifdef DEBUG_STATE
-        stateChange = true;
-        #endif
-        
-        break;
-  
-  
-      ////////////////////////////////
-      // ANNEAL_TIMER
-      //
-      // Keep track of the time, and
-      // stop annealing at the right
-      // set point.
-      // Update the display for timer,
-      // amps, and volts - nothing else
-      // needs to change. 
-      // Reset timers on LCD display
-      ////////////////////////////////
-  
-      case ANNEAL_TIMER:
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter ANNEAL_TIMER")); stateChange = false; }
-        #endif
-  
-        if (Timer.hasPassed(floor((annealSetPoint * 1000.0) + 0.5))) {  // if we're done...
-          digitalWrite(INDUCTOR_PIN, LOW);
-          digitalWrite(LED_BUILTIN, LOW);
-          annealState = DROP_CASE;
-          Timer.restart();
-          lcd.setFastBacklight(BLUE);
-          updateLCDState();
-          LCDTimer.restart();
-          
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-        }    
-        
-        if (AnnealPowerSensors.hasPassed(ANNEAL_POWER_INTERVAL)) {
-          checkPowerSensors(false);
-          AnnealPowerSensors.restart();
-          updateLCDPowerDisplay(true);
-        }
-
-  
-        // don't update the LCD if we're within 200 millseconds of ending the anneal cycle, so 
-        // we don't overrun while out to lunch. annealSetPoint is a float in seconds, and we
-        // need to convert it to milliseconds
-        if ( (Timer.elapsed() < (int)((annealSetPoint * 1000) - 200)) && AnnealLCDTimer.hasPassed(ANNEAL_LCD_TIMER_INTERVAL)) {
-           updateLCDTimer(true);
-           AnnealLCDTimer.restart();
-        }
-  
-        break;
-  
-      ////////////////////////////////
-      // DROP_CASE
-      //
-      // Trigger the solenoid and start
-      // the solenoid timer. Update
-      // the display once, so Timer goes 
-      // back to 0.00 (by annealState in
-      // updateLCDTimer)
-      ////////////////////////////////
-   
-      case DROP_CASE: 
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter DROP_CASE")); stateChange = false; }
-        #endif
-        
-        digitalWrite(SOLENOID_PIN, HIGH);
-        annealState = DROP_CASE_TIMER;
-        updateLCDTimer(true);
-  
-        #ifdef DEBUG_STATE
-        stateChange = true;
-        #endif
-        
-        break;
-  
-  
-      ////////////////////////////////
-      // DROP_CASE_TIMER
-      //
-      // Close the solenoid at the right time
-      // Update the display on normal cycle
-      ////////////////////////////////
-  
-      case DROP_CASE_TIMER:
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter DROP_CASE_TIMER")); stateChange = false; }
-        #endif
-  
-        // this timing isn't critical, so we'll just update normally, now
-        if ( LCDTimer.hasPassed(LCD_UPDATE_INTERVAL) ) {
-          updateLCD(false);
-          LCDTimer.restart();
-        }
-        
-        if (Timer.hasPassed((int) caseDropSetPoint * 1000)) {
-          digitalWrite(SOLENOID_PIN, LOW);
-          annealState = DELAY;
-          Timer.restart();
-          updateLCDState();
-  
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-          break;
-        }
-  
-        break;
-  
-  
-      ////////////////////////////////
-      // DELAY
-      //
-      // Duty cycle to allow heat to 
-      // dissipate a bit. 
-      // Normal display handling and sensor
-      // updates
-      ////////////////////////////////
-      
-      case DELAY:
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter DELAY")); stateChange = false; }
-        #endif
-  
-        if ( LCDTimer.hasPassed(LCD_UPDATE_INTERVAL) ) {
-          updateLCD(false);
-          LCDTimer.restart();
-        }
-        
-        if (Timer.hasPassed((int) delaySetPoint * 1000)) {
-          annealState = WAIT_CASE;
-          if (startOnOpto) {
-            lcd.setFastBacklight(GREEN);
-          }
-          
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-  
-        }
-        break;
-        
-   
-    } // switch(annealState)
-
+    annealFsm.run();
   
  }
@@ -0,0 +1,342 @@
+/**************************************************************************************************
+ *
+ * AnnealStats.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Timing statistics - fixed bucket histograms that are cheap enough to update from inside the
+ * control loop, plus the anneal timing accuracy numbers built on top of them.
+ *
+ * Buckets are half an octave wide: values 0-3 get a bucket each, and past that every power of
+ * two is split in two. That keeps percentiles within about 25% of the real value for anything
+ * from a handful of microseconds up to a couple of seconds, with no floats and no division in
+ * histogramAdd(). Buckets are 16 bits - when one is about to overflow, they're all halved, so the
+ * percentiles lean towards recent values from then on.
+ *
+ * The dwell histograms track how long each pass through an AnnealState lasts, in milliseconds,
+ * so we can see where a cycle's time actually goes - waiting on the opto, the trap door, the
+ * cooling delay. annealDwellTrack() is the state machine engine's hook on every transition,
+ * so none of the states need to know about it.
+ *
+ * The loop profiler is the same idea, on a smaller scale - see LoopProfile in Annealer-Control.h.
+ * It times every pass of loop(), all the time and on every board, so the Data Display menu can
+ * show whether the LCD or the log is eating into the control loop on a real run, not just on
+ * the bench. Only the dwell histograms need ANNEAL_STATS.
+ *
+ **************************************************************************************************/
+
+#include "Annealer-Control.h"
+
+TimingHistogram annealLateness;   // microseconds the inductor stayed on past annealSetPoint
+
+float annealLateP50 = 0;          // milliseconds - shown in the Data Display menu
+float annealLateP99 = 0;
+float annealLateMax = 0;
+
+#ifdef ANNEAL_STATS
+float annealDwellP50[ANNEAL_STATES];          // seconds - shown in the Data Display menu
+TimingHistogram annealDwell[ANNEAL_STATES];   // milliseconds per visit to each state
+AnnealState dwellState = WAIT_BUTTON;         // the state we're timing
+unsigned long dwellEnterMillis = 0;
+#endif
+
+LoopProfile loopProfiles[LOOP_PROFILES];
+unsigned long loopStartMicros = 0;
+uint8_t loopProfileIndex = LOOP_PROFILE_MENU;   // where this pass gets charged
+
+int loopProfileSel = ANNEAL_TIMER;            // which profile the Data Display menu shows
+float loopMinMs = 0;
+float loopMeanMs = 0;
+float loopP99Ms = 0;
+float loopMaxMs = 0;
+
+
+/*
+ * histogramBucket
+ *
+ * Figure out which bucket a value lands in. Bucket 2n covers [2^n, 1.5 * 2^n), and bucket
+ * 2n+1 covers [1.5 * 2^n, 2^(n+1)).
+ */
+static uint8_t histogramBucket(unsigned long value) {
+  uint8_t msb = 0;
+
+  if (value < 4) return value;
+
+  while (value >> (msb + 1)) msb++;
+
+  uint8_t bucket = (msb * 2) + ((value >> (msb - 1)) & 1);
+  return (bucket < HISTOGRAM_BUCKETS) ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// smallest value that would land in the *next* bucket
+static unsigned long histogramBucketLimit(uint8_t bucket) {
+  if (bucket < 3) return bucket + 1;
+  bucket++;
+  return (1UL << (bucket / 2)) + ((bucket & 1) ? (1UL << ((bucket / 2) - 1)) : 0);
+}
+
+void histogramReset(TimingHistogram &h) {
+  memset(&h, 0, sizeof(h));
+}
+
+void histogramAdd(TimingHistogram &h, unsigned long value) {
+  if ((h.count == 0) || (value < h.minimum)) h.minimum = value;
+  if (value > h.maximum) h.maximum = value;
+  h.total += value;
+  h.count++;
+
+  uint8_t bucket = histogramBucket(value);
+  if (h.buckets[bucket] == 0xFFFF) {
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) h.buckets[i] >>= 1;
+  }
+  h.buckets[bucket]++;
+}
+
+unsigned long histogramMean(const TimingHistogram &h) {
+  return h.count ? (h.total / h.count) : 0;
+}
+
+/*
+ * histogramPercentile
+ *
+ * Returns the upper edge of the bucket that holds the pct'th percentile - clamped to the real
+ * maximum we've seen, so p100 is exact. The last bucket also catches everything too big for the
+ * rest, so it has no upper edge - anything landing there is the maximum.
+ */
+unsigned long histogramPercentile(const TimingHistogram &h, uint8_t pct) {
+  unsigned long counted = 0;
+  unsigned long seen = 0;
+  unsigned long target;
+
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) counted += h.buckets[i];
+  if (counted == 0) return 0;
+  target = ((counted * pct) + 99) / 100;
+
+  for (uint8_t i = 0; i < (HISTOGRAM_BUCKETS - 1); i++) {
+    seen += h.buckets[i];
+    if (seen >= target) {
+      unsigned long limit = histogramBucketLimit(i) - 1;
+      return (limit < h.maximum) ? limit : h.maximum;
+    }
+  }
+  return h.maximum;
+}
+
+/*
+ * histogramPrint
+ *
+ * Dump a histogram as one line of summary, then one line per non-empty bucket:
+ *   <label> n=<count> min=<min> mean=<mean> p50=<p50> p99=<p99> max=<max>
+ *     <bucket low>-<bucket high>: <count>
+ */
+void histogramPrint(Print &p, const __FlashStringHelper *label, const TimingHistogram &h) {
+  p.print(label);
+  p.print(F(" n="));    p.print(h.count);
+  p.print(F(" min="));  p.print(h.minimum);
+  p.print(F(" mean=")); p.print(histogramMean(h));
+  p.print(F(" p50="));  p.print(histogramPercentile(h, 50));
+  p.print(F(" p99="));  p.print(histogramPercentile(h, 99));
+  p.print(F(" max="));  p.println(h.maximum);
+
+  for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    if (h.buckets[i]) {
+      p.print(F("  "));
+      p.print(i ? histogramBucketLimit(i - 1) : 0);
+      p.print(F("-"));
+      p.print(histogramBucketLimit(i) - 1);
+      p.print(F(": "));
+      p.println(h.buckets[i]);
+    }
+  }
+}
+
+
+/*
+ * annealRecordLateness
+ *
+ * Called once per anneal cycle, right after the inductor goes off. onMicros is how long the
+ * inductor was actually powered - we compare it against what annealSetPoint asked for, rounded
+ * to the millisecond the same way START_ANNEAL arms the cutoff, and update the Data Display
+ * numbers.
+ */
+void annealRecordLateness(unsigned long onMicros) {
+  unsigned long setMicros = (unsigned long) floor((annealSetPoint * 1000.0) + 0.5) * 1000UL;
+  unsigned long late = (onMicros > setMicros) ? (onMicros - setMicros) : 0;
+
+  histogramAdd(annealLateness, late);
+
+  annealLateP50 = histogramPercentile(annealLateness, 50) / 1000.0;
+  annealLateP99 = histogramPercentile(annealLateness, 99) / 1000.0;
+  annealLateMax = annealLateness.maximum / 1000.0;
+
+  #ifdef DEBUG
+  Serial.print(F("DEBUG: anneal set "));
+  Serial.print(setMicros);
+  Serial.print(F("us, on "));
+  Serial.print(onMicros);
+  Serial.print(F("us, late "));
+  Serial.println(late);
+  histogramPrint(Serial, F("DEBUG: lateness us"), annealLateness);
+  #endif
+}
+
+
+/*
+ * annealDwellBegin
+ *
+ * Start timing whatever state we're in now - called when we enter annealing mode, so the time
+ * spent in the menus doesn't count. Without ANNEAL_STATS, the dwell functions do nothing.
+ */
+void annealDwellBegin(void) {
+  #ifdef ANNEAL_STATS
+  dwellState = annealState;
+  dwellEnterMillis = halMillis();
+  #endif
+}
+
+/*
+ * annealDwellTrack
+ *
+ * Called by the state machine engine on every transition - the state we left gets its dwell
+ * time recorded.
+ */
+void annealDwellTrack(void) {
+  #ifdef ANNEAL_STATS
+  unsigned long now;
+
+  if (annealState == dwellState) return;
+
+  now = halMillis();
+  histogramAdd(annealDwell[dwellState], now - dwellEnterMillis);
+  annealDwellP50[dwellState] = histogramPercentile(annealDwell[dwellState], 50) / 1000.0;
+
+  dwellState = annealState;
+  dwellEnterMillis = now;
+  #endif
+}
+
+#ifdef ANNEAL_STATS
+static const __FlashStringHelper *annealStateName(uint8_t state) {
+  switch (state) {
+    case WAIT_BUTTON:     return F("WAIT_BUTTON ms");
+    case WAIT_CASE:       return F("WAIT_CASE ms");
+    case START_ANNEAL:    return F("START_ANNEAL ms");
+    case ANNEAL_TIMER:    return F("ANNEAL_TIMER ms");
+    case DROP_CASE:       return F("DROP_CASE ms");
+    case DROP_CASE_TIMER: return F("DROP_CASE_TIMER ms");
+    case DELAY:           return F("DELAY ms");
+  }
+  return F("? ms");
+}
+
+static void annealDwellPrint(Print &p) {
+  for (uint8_t i = 0; i < ANNEAL_STATES; i++) {
+    histogramPrint(p, annealStateName(i), annealDwell[i]);
+  }
+  p.println();
+}
+#endif
+
+/*
+ * annealDwellDump
+ *
+ * Print all the dwell histograms to Serial, and append them to DWELL_LOG_FILE on the OpenLog
+ * if we're using it - from the Data Display menu
+ */
+void annealDwellDump(void) {
+  #ifdef ANNEAL_STATS
+  boolean newFile;
+
+  annealDwellPrint(Serial);
+
+  if (mayanUseSD && annealLogOpenText(DWELL_LOG_FILE, newFile)) {
+    annealDwellPrint(annealLogPrint());
+    annealLogFlush();
+  }
+  #else
+  Serial.println(F("Dwell histograms are off - see ANNEAL_STATS"));
+  #endif
+}
+
+
+/*
+ * loopProfileStart / loopProfileEnd
+ *
+ * Bracket each pass of loop(). The pass is charged to the state we were in when it started,
+ * since that's the state whose work it did.
+ */
+void loopProfileStart(void) {
+  if (menuState == ANNEALING) loopProfileIndex = annealState;
+  else if (menuState == MAYAN) loopProfileIndex = LOOP_PROFILE_MAYAN;
+  else loopProfileIndex = LOOP_PROFILE_MENU;
+
+  loopStartMicros = halMicros();
+}
+
+void loopProfileEnd(void) {
+  unsigned long us = halMicros() - loopStartMicros;
+  unsigned long scaled = us >> LOOP_BUCKET_SHIFT;
+  LoopProfile &p = loopProfiles[loopProfileIndex];
+  uint8_t bucket = 0;
+
+  while ((bucket < (LOOP_BUCKETS - 1)) && (scaled >> bucket)) bucket++;
+
+  if (p.buckets[bucket] == (LoopCount) ~0) {
+    for (uint8_t i = 0; i < LOOP_BUCKETS; i++) p.buckets[i] >>= 1;
+  }
+  p.buckets[bucket]++;
+
+  if ((p.count == 0) || (us < p.minimum)) p.minimum = us;
+  if (us > p.maximum) p.maximum = us;
+  p.total += us;
+  p.count++;
+}
+
+// upper edge of the bucket holding the pct'th percentile, clamped to the real maximum
+static unsigned long loopProfilePercentile(const LoopProfile &p, uint8_t pct) {
+  unsigned long counted = 0;
+  unsigned long seen = 0;
+  unsigned long target;
+
+  for (uint8_t i = 0; i < LOOP_BUCKETS; i++) counted += p.buckets[i];
+  if (counted == 0) return 0;
+  target = ((counted * pct) + 99) / 100;
+
+  for (uint8_t i = 0; i < (LOOP_BUCKETS - 1); i++) {
+    seen += p.buckets[i];
+    if (seen >= target) {
+      unsigned long limit = (1UL << (i + LOOP_BUCKET_SHIFT)) - 1;
+      return (limit < p.maximum) ? limit : p.maximum;
+    }
+  }
+  return p.maximum;
+}
+
+/*
+ * loopProfileShow
+ *
+ * Fill in the Data Display numbers for the profile picked in loopProfileSel
+ */
+void loopProfileShow(void) {
+  const LoopProfile &p = loopProfiles[(loopProfileSel < LOOP_PROFILES) ? loopProfileSel : LOOP_PROFILE_MENU];
+
+  loopMinMs = p.minimum / 1000.0;
+  loopMeanMs = (p.count ? (unsigned long) (p.total / p.count) : 0) / 1000.0;
+  loopP99Ms = loopProfilePercentile(p, 99) / 1000.0;
+  loopMaxMs = p.maximum / 1000.0;
+}
+
+
+#ifdef DEBUG_COSTMODEL
+/*
+ * costModelCharge
+ *
+ * Burn a fixed number of microseconds - used to stand in for a slow LCD or sensor call, so we
+ * can see how much each one stretches the anneal without needing slower hardware on the bench.
+ */
+void costModelCharge(unsigned long us) {
+  unsigned long start = halMicros();
+  while ((halMicros() - start) < us) ;
+}
+#endif
@@ -0,0 +1,89 @@
+/**************************************************************************************************
+ *
+ * AnnealThermistor.h
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Thermistor lookup table, built by the compiler. Instead of working the beta equation out on
+ * every reading (a divide, a log(), and three more divides - all software floating point on an
+ * AVR), we work it out once per table entry at compile time, from THERM_NOMINAL, THERM_NOM_TEMP,
+ * THERM_BETA, THERM_RESISTOR, and RESOLUTION_MAX, and interpolate between entries at run time.
+ *
+ * The table has 2^THERM_LUT_BITS segments spread evenly over the ADC range - 257 entries, in
+ * tenths of a degree F, 514 bytes of flash. Against the exact formula, the interpolated value
+ * is within 0.2F from 0-250F and 0.5F up to 300F, for both the 10 and 14 bit ADCs, and built in
+ * double or float (extras/HostSim/ThermistorTest.cpp checks). Accuracy falls off way out past
+ * that, at the hot end of the range, where the curve gets steep - but there's nothing on the
+ * annealer that should ever read that high.
+ *
+ * Everything in here is C++11 constexpr, so it has to be written as one-line recursive
+ * functions - that's why thermLn() looks the way it does.
+ *
+ **************************************************************************************************/
+
+#ifndef _ANNEAL_THERMISTOR_H
+#define _ANNEAL_THERMISTOR_H
+
+#include "Annealer-Control.h"
+#include <avr/pgmspace.h>
+
+#define THERM_LUT_BITS      8
+#define THERM_LUT_SIZE      ((1 << THERM_LUT_BITS) + 1)
+#define THERM_LUT_STEP      (RESOLUTION_MAX >> THERM_LUT_BITS)    // ADC counts per segment
+
+static_assert((THERM_LUT_STEP << THERM_LUT_BITS) == RESOLUTION_MAX, "RESOLUTION_MAX must be a power of two");
+
+// thermLn(x) - reduce x to [0.5, 2) by powers of two, then the atanh series, which converges
+// quickly there: thermLn(m) = 2 * (y + y^3/3 + y^5/5 + ...), y = (m - 1) / (m + 1)
+//
+// R is the type the compiler does the math in - double, which is only 32 bits on an AVR. The
+// host test in extras/HostSim builds the table in float as well, to check that it holds up there.
+template <typename R> constexpr R thermLnSeries(R y2, R term, int n) {
+  return (n > 41) ? R(0.0) : R(term / n) + thermLnSeries<R>(y2, R(term * y2), n + 2);
+}
+template <typename R> constexpr R thermLnReduced(R y) {
+  return R(2.0) * thermLnSeries<R>(R(y * y), y, 1);
+}
+template <typename R> constexpr R thermLn(R x, int k = 0) {
+  return (x >= R(2.0)) ? thermLn<R>(R(x / R(2.0)), k + 1) :
+         (x < R(0.5))  ? thermLn<R>(R(x * R(2.0)), k - 1) :
+                         R(k * R(0.69314718055994531)) + thermLnReduced<R>(R((x - R(1.0)) / (x + R(1.0))));
+}
+
+// same math as the old calcSteinhart() - ADC counts to degrees F
+template <typename R> constexpr R thermResistance(R counts) {
+  return R(THERM_RESISTOR) / (R(R(RESOLUTION_MAX) / counts) - R(1.0));
+}
+template <typename R> constexpr R thermKelvin(R counts) {
+  return R(1.0) / (R(thermLn<R>(R(thermResistance<R>(counts) / R(THERM_NOMINAL))) / R(THERM_BETA)) + R(R(1.0) / R(THERM_NOM_TEMP + 273.15)));
+}
+template <typename R> constexpr R thermFahrenheit(R counts) {
+  return R(R(thermKelvin<R>(counts) - R(273.15)) * R(1.8)) + R(32.0);
+}
+
+// the very ends of the ADC range are 0 and infinite ohms - nudge them in by a count
+template <typename R> constexpr R thermEntryCounts(int i) {
+  return (i == 0) ? R(1.0) : (i == (1 << THERM_LUT_BITS)) ? R(RESOLUTION_MAX - 1.0) : R((long) i * THERM_LUT_STEP);
+}
+template <typename R> constexpr int16_t thermClampTenths(R tenths) {
+  return (tenths > R(32767.0)) ? 32767 : (tenths < R(-32768.0)) ? -32768 : (int16_t) (tenths + ((tenths < 0) ? R(-0.5) : R(0.5)));
+}
+template <typename R> constexpr int16_t thermEntry(int i) {
+  return thermClampTenths<R>(R(thermFahrenheit<R>(thermEntryCounts<R>(i)) * R(10.0)));
+}
+
+// 0, 1, ... N-1 as a parameter pack, so the table can be written as { thermEntry(I)... }
+template <int... I> struct ThermIndices {};
+template <int N, int... I> struct ThermMakeIndices : ThermMakeIndices<N - 1, N - 1, I...> {};
+template <int... I> struct ThermMakeIndices<0, I...> { typedef ThermIndices<I...> type; };
+
+template <typename R, typename T> struct ThermTable;
+template <typename R, int... I> struct ThermTable<R, ThermIndices<I...> > {
+  static const int16_t tenths[sizeof...(I)];
+};
+template <typename R, int... I> const int16_t ThermTable<R, ThermIndices<I...> >::tenths[sizeof...(I)] PROGMEM = { thermEntry<R>(I)... };
+
+typedef ThermTable<double, ThermMakeIndices<THERM_LUT_SIZE>::type> ThermLUT;
+
+#endif // _ANNEAL_THERMISTOR_H
@@ -16,6 +16,7 @@
 #include <Wire.h>
 #include <SparkFun_Qwiic_OpenLog_Arduino_Library.h>
 #include <ctype.h> 
+#include "AnnealFilters.h"
 
 /*
  * DEBUG - uncomment the #define to set us to DEBUG mode! Make sure you open a serial 
@@ -29,11 +30,56 @@
  */
 
 // #define DEBUG
-// #define DEBUG_LOOPTIMING
 // #define DEBUG_STATE
 // #define DEBUG_LCD
 // #define DEBUG_MAYAN
 
+/*
+ * Timing accuracy test options - these are for bench work with the inductor board unplugged,
+ * not for annealing brass!
+ * 
+ * DEBUG_COSTMODEL burns a fixed number of microseconds in each LCD field update and sensor
+ * read, so we can see how slow display or sensor calls stretch the anneal. The host simulation
+ * under extras/HostSim sets its own costs - see its Makefile.
+ * 
+ * DEBUG_TIMING_SWEEP bumps annealSetPoint by TIMING_SWEEP_STEP every cycle, wrapping around
+ * the full 0-20 second range. Turn Case Detect off and let it run - the lateness numbers show
+ * up in the Data Display menu.
+ */
+// #define DEBUG_COSTMODEL
+// #define DEBUG_TIMING_SWEEP
+
+#ifdef DEBUG_COSTMODEL
+#ifndef COSTMODEL_LCD_MICROS
+#define COSTMODEL_LCD_MICROS    2000    // per LCD field print
+#endif
+#ifndef COSTMODEL_POWER_MICROS
+#define COSTMODEL_POWER_MICROS  300     // per checkPowerSensors call
+#endif
+#endif
+
+#ifdef DEBUG_TIMING_SWEEP
+#define TIMING_SWEEP_STEP       0.37    // seconds - odd step so we hit lots of different set points
+#define TIMING_SWEEP_MAX        20.0
+#endif
+
+/*
+ * Log format - Mayan runs go to the OpenLog in a compact binary format (see AnnealLogFormat.h,
+ * and extras/AnnealLogDecode turns the files back into CSV on a PC). Uncomment LOG_FORMAT_CSV to
+ * write plain "cycle,timestamp,amps,volts" text lines instead - about seven times the bytes.
+ */
+// #define LOG_FORMAT_CSV
+
+#ifdef LOG_FORMAT_CSV
+#define LOG_FILE_EXT          ".CSV"
+#else
+#define LOG_FILE_EXT          ".BIN"
+#endif
+#define LOG_LINE_LENGTH       40      // longest CSV line, with room to spare
+#define BATCH_LOG_FILE        "BATCH.CSV" // annealing batch summaries, always text
+#define DWELL_LOG_FILE        "DWELL.TXT" // state dwell histogram dumps
+#define DELAY_LOG_FILE        "DELAY.CSV" // delay governor's pick for each cycle
+
 
 // Select the pin layout needed based on which annealer shield is in play. If none, 
 // set up the right pin layout for your installation.
@@ -118,17 +164,30 @@
 #define THERM_NOM_TEMP      25      //Nominal temperature in DegC
 #define THERM_BETA          3950    //Beta coefficient for thermistor
 #define THERM_RESISTOR      10000   //Value of resistor in series with thermistor
-#define THERM_SMOOTH_RATIO  0.35    // What percentage of the running average is the latest reading - used to smooth analog input
 
 #ifdef _AP3_VARIANT_H_
 #define INT_TEMP_SMOOTH_RATIO 0.35
 #endif
 
-// Power sensor values
-#define AMPS_SMOOTH_RATIO   0.50
-#define VOLTS_SMOOTH_RATIO  0.50
-#define MAYAN_AMPS_SMOOTH_RATIO   0.50
-#define MAYAN_VOLTS_SMOOTH_RATIO  0.50
+// Power sensor values - every sampler tick reads current and voltage 4^POWER_OVERSAMPLE_BITS
+// times each (after the HAL's one to settle), decimated to POWER_OVERSAMPLE_BITS more bits than
+// the ADC has, and a sample is SAMPLER_TICKS of those added up. The synchronous reset reading is
+// one sample's worth, done the same way. That knocks the noise down on its own, so Mayan mode
+// takes every reading as is - any smoothing there just delays spotting the peak. Every bit here
+// is four times the conversions in every tick - see SAMPLER_TICK_CONVERSIONS
+#define POWER_OVERSAMPLE_BITS     1       // 4 conversions (plus one to settle) per channel, per tick
+#define POWER_TICK_SCALE          (1 << POWER_OVERSAMPLE_BITS)          // a tick's reading, in ADC counts
+#define POWER_SAMPLE_SCALE        (POWER_TICK_SCALE * SAMPLER_TICKS)    // and a sample's
+#define THERM2_OVERSAMPLE_BITS    2       // 16 conversions (plus one to settle) a reading
+
+// Sensor smoothing - which filter from AnnealFilters.h each channel runs through, per mode. They
+// all work on the sampler's raw ADC sums, once per sample (SAMPLER_PERIOD_MS)
+typedef EmaFilter<1, 1>   AnnealAmpsFilter;     // half the newest sample
+typedef EmaFilter<1, 1>   AnnealVoltsFilter;
+typedef EmaFilter<1, 0>   MayanAmpsFilter;      // no smoothing at all
+typedef EmaFilter<1, 0>   MayanVoltsFilter;
+typedef EmaFilter<45, 7>  Therm1Filter;         // 45/128, about 0.35 of the newest sample
+typedef EmaFilter<45, 7>  Therm2Filter;         // same, but once per ANALOG_INTERVAL - see checkThermistors()
 
 #ifdef _AP3_VARIANT_H_
 #define VOLTS_PER_RESOLUTION  0.0029296875 // 48v over 14-bit resolution - 48 divided by 16384
@@ -136,6 +195,10 @@
 #define VOLTS_PER_RESOLUTION  0.046875  // 48v over 10-bit resolution - 48 divided by 1024
 #endif
 
+// Current sensor - reads AMPS_ZERO_VOLTS with no current flowing, and AMPS_PER_VOLT past that
+#define AMPS_ZERO_VOLTS       1.0
+#define AMPS_PER_VOLT         100.0
+
 // EEPROM addresses - int is 2 bytes, so make sure these are even numbers!
 #define ANNEAL_ADDR   0
 #define DELAY_ADDR    4
@@ -147,6 +210,12 @@
 #define CASE_STORED_ARRAY_START_ADDR 200 // this address keeps it out of the way, well past the names, extends to 240 (10 floats)
 #define NUM_CASES 10
 #define MAYAN_USE_SD_ADDR 300
+#define LOG_SEQ_ADDR 304          // next log file number, and its complement as a check - 4 bytes
+#define BATCH_SIZE_ADDR 308       // int - 4 bytes on the Apollo3, so keep 4 byte spacing from here on
+#define DELAY_GOVERNOR_ADDR 312
+#define DELAY_CEILING_ADDR 316    // float - 4 bytes
+#define ANNEAL_ENERGY_ADDR 320    // float - 4 bytes
+#define CASE_ENERGY_ARRAY_START_ADDR 324 // 10 floats, extends to 364
 
 // Control constants
 #define CASE_DROP_DELAY_DEFAULT   50      // hundredths of seconds
@@ -159,6 +228,20 @@
 #define ANNEAL_LCD_TIMER_INTERVAL 100     // milliseconds - interval to update LCD timer during active anneal
 #define ANNEAL_POWER_INTERVAL     250     // millseconds  - interval to check and update power sensors during active anneal
 #define DEBOUNCE_MICROS           100000  // MICROseconds
+#define BATCH_SIZE_MAX            999     // cases - has to fit the LCD readout
+
+// Delay governor - AnnealGovernor.cpp. delaySetPoint is the pause with the coil right at the
+// ceiling; DELAY_GOVERNOR_BAND degrees below that it drops to nothing, and past the ceiling it
+// keeps stretching, up to DELAY_GOVERNOR_MAX_SCALE times delaySetPoint
+#define DELAY_CEILING_DEFAULT     140.0   // degrees F
+#define DELAY_CEILING_MIN         80.0
+#define DELAY_CEILING_MAX         250.0
+#define DELAY_GOVERNOR_BAND       30.0    // degrees F
+#define DELAY_GOVERNOR_MAX_SCALE  3.0
+
+// Energy cutoff - AnnealSampler.cpp integrates volts x amps while the inductor is on, and with
+// an energy set point, cuts it off there. The time set point stays as the hard limit
+#define ANNEAL_ENERGY_MAX         20000.0 // joules
 
 // LCD contstants
 #define LCD_SETPOINT_LABEL  0,0
@@ -175,6 +258,22 @@
 #define LCD_2NDTEMP         16,2
 #define LCD_STATE_LABEL     0,3
 #define LCD_STATE           7,3
+#define LCD_COLS            20
+#define LCD_ROWS            4
+
+// LCD flush budget - estimated microseconds of blocking I2C per loop pass. The costs follow the
+// settle delays inside the SerLCD library, which dwarf the actual bus time
+#define LCD_COST_CURSOR       50000   // setCursor is a "special command"
+#define LCD_COST_WRITE        10000   // any run of characters
+#define LCD_COST_CHAR         30      // ...plus this per character at 400kHz
+#define LCD_COST_BACKLIGHT    10000
+#define LCD_BUDGET_STRICT     (LCD_COST_CURSOR + LCD_COST_WRITE + (LCD_COST_CHAR * LCD_COLS)) // one field per pass
+#define LCD_BUDGET_RELAXED    1000000 // everything
+
+// OpenLog write pacing - log lines get packed into blocks, and at most one block goes out per
+// LOG_PACE_MS, which keeps us from overrunning the OpenLog's receive buffer
+#define LOG_BLOCK_SIZE        32      // one I2C transaction's worth
+#define LOG_PACE_MS           15
 
 #define RED       255,20,20
 #define GREEN     20,255,20
@@ -186,12 +285,125 @@
 #define ANALOG_INTERVAL       1000
 #define LCDSTARTUP_INTERVAL   1000
 
+#define HISTOGRAM_BUCKETS     40  // half-octave buckets - covers values up to 2^20
+
+#define ANNEAL_STATES         (DELAY + 1)   // one dwell histogram per AnnealState
+#define MAYAN_STATES          (ABORTED + 1)
+
+// The dwell histograms are a bench tool, and they take 700 bytes of RAM - nothing on the
+// Artemis, but a third of an Uno. On AVR they're off unless you turn them on here, and the loop
+// profiler below drops to its smaller layout
+#ifndef __AVR__
+#define ANNEAL_STATS
+#endif
+// #define ANNEAL_STATS
+
+/*
+ * Loop profiler - how long each pass of loop() takes, in microseconds, kept separately for each
+ * AnnealState, then the menu, then Mayan mode. It's always on, so it has to be small and cheap:
+ * whole octave buckets - coarser than the half-octave HISTOGRAM_BUCKETS above - small counts,
+ * and when a count is about to overflow, every bucket in that profile is halved - the
+ * percentiles lean towards recent passes, which is what we want anyway.
+ *
+ * Without ANNEAL_STATS, it's cut down to fit an AVR: the buckets start at 256us, and the counts
+ * are 8 bits. That's 288 bytes for all nine profiles, down from 540.
+ */
+#ifdef ANNEAL_STATS
+#define LOOP_BUCKETS          20            // bucket n is [2^(n-1), 2^n) - the last catches the rest
+#define LOOP_BUCKET_SHIFT     0
+typedef uint16_t LoopCount;
+#else
+#define LOOP_BUCKETS          12            // the same, counting in 2^LOOP_BUCKET_SHIFT us
+#define LOOP_BUCKET_SHIFT     8
+typedef uint8_t LoopCount;
+#endif
+#define LOOP_PROFILE_MENU     ANNEAL_STATES
+#define LOOP_PROFILE_MAYAN    (ANNEAL_STATES + 1)
+#define LOOP_PROFILES         (ANNEAL_STATES + 2)
+
+struct LoopProfile {
+  unsigned long count;
+  unsigned long minimum;
+  unsigned long maximum;
+  uint64_t total;
+  LoopCount buckets[LOOP_BUCKETS];
+};
+
+// same halving trick as the loop profiler when a bucket fills - count, min, max, and total
+// stay exact
+struct TimingHistogram {
+  unsigned long count;
+  unsigned long minimum;
+  unsigned long maximum;
+  uint64_t total;
+  uint16_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/*
+ * Background sensor sampler - AnnealSampler.cpp
+ * 
+ * A timer interrupt reads the current, voltage, and thermistor pins every SAMPLER_TICK_MS, and
+ * every SAMPLER_TICKS of those become one SensorSample - the raw conversions summed, and stamped
+ * with the time it closed. Samples queue up in a small ring for the state machines to pick up.
+ */
+#define SAMPLER_TICK_MS       10
+#define SAMPLER_TICKS         5       // ticks per sample
+#define SAMPLER_PERIOD_MS     (SAMPLER_TICK_MS * SAMPLER_TICKS)
+#define SAMPLER_READS         2       // thermistor conversions per tick - after one to settle
+#define SAMPLER_SAMPLE_READS  (SAMPLER_READS * SAMPLER_TICKS)
+// all of one tick, settles and all - current and voltage, then the thermistor
+#define SAMPLER_TICK_CONVERSIONS  ((2 * ((1 << (2 * POWER_OVERSAMPLE_BITS)) + 1)) + (SAMPLER_READS + 1))
+#define SAMPLER_RING_SIZE     16      // power of two - 800ms worth
+
+struct SensorSample {
+  unsigned long timestamp;    // halMillis() when the sample closed
+  uint32_t amps;              // sums of SAMPLER_TICKS oversampled readings - POWER_SAMPLE_SCALE ADC counts
+  uint32_t volts;
+  uint32_t therm1;            // sum of SAMPLER_SAMPLE_READS raw ADC conversions
+};
+
+/*
+ * Case detect opto sensors - AnnealOpto.cpp
+ * 
+ * A pin change interrupt stamps each edge and queues it, and the state machine reads back
+ * whether there's a case, and when it got there.
+ */
+#define OPTO_QUEUE_SIZE       8       // power of two - edges
+#define OPTO_GLITCH_MS        5       // a dropout shorter than this is still the same case
+#define OPTO_CASE_DETECT      0       // OPTO1_PIN
+#ifdef OPTO2_PIN
+  #define OPTO_SENSOR2        1       // OPTO2_PIN
+  #define OPTO_SENSORS        2
+#else
+  #define OPTO_SENSORS        1
+#endif
+
+/*
+ * Cooperative scheduler - AnnealScheduler.cpp
+ * 
+ * The periodic jobs loop() runs, outside the menu system. Each gets a period and a priority in
+ * setup(), and between jobs, the CPU sleeps until the next interrupt.
+ */
+#define SCHED_SLEEP_MIN_MS    SAMPLER_TICK_MS   // the sampler's ticker wakes us at least this often
+
+enum SchedJob
+{
+  SCHED_LOG,            // drain the OpenLog queue
+  SCHED_ANNEAL_TIMER,   // LCD timer, while the inductor's on
+  SCHED_ANNEAL_POWER,   // LCD amps and volts, likewise
+  SCHED_THERMISTORS,
+  SCHED_LCD,            // the normal LCD refresh
+  SCHED_JOBS
+};
+
 struct StoredCase {
   char name[13] = "unused      ";
   float time = ANNEAL_TIME_DEFAULT / 100.0;
+  float energy = 0.0;   // joules - 0 to anneal on time alone
   StoredCase& operator=(StoredCase& o) {
     strncpy(name,o.name,12);
     time=o.time;
+    energy=o.energy;
     return o;
   }
 };
@@ -243,6 +455,11 @@ extern float Therm1Avg;
 extern float Therm1Temp;
 extern float Therm1TempHigh;  // track highest temp we saw
 
+#ifdef THERM2_PIN
+extern float Therm2Temp;
+extern float Therm2TempHigh;
+#endif
+
 #ifdef _AP3_VARIANT_H_
 extern float internalTemp;
 extern float internalTempHigh;  // track highest temp we saw
@@ -250,51 +467,74 @@ extern float internalTempHigh;  // track highest temp we saw
 
 extern SerLCD lcd;
 extern Chrono Timer;
-extern Chrono AnalogSensors; 
-extern Chrono AnnealPowerSensors;
-extern Chrono AnnealLCDTimer;
-extern Chrono LCDTimer;
 
 extern float annealSetPoint;
 extern float delaySetPoint;
 extern float caseDropSetPoint;
+extern float annealEnergySetPoint;
+extern float annealEnergyLast;
+extern float delayCeiling;
 extern float mayanAccRec;
 extern float mayanRecommendation;
 extern float lastMayanRecommendation;
+extern float annealLateP50;
+extern float annealLateP99;
+extern float annealLateMax;
+#ifdef ANNEAL_STATS
+extern float annealDwellP50[];
+#endif
+extern int loopProfileSel;
+extern float loopMinMs;
+extern float loopMeanMs;
+extern float loopP99Ms;
+extern float loopMaxMs;
 
 extern boolean showedScreen;
 extern boolean startOnOpto;
 extern boolean mayanUseSD; 
+extern boolean delayGovernor;
 
 extern int encoderDiff;
 extern int storedSetPoint; 
 extern int storedDelaySetPoint;
 extern int storedCaseDropSetPoint;
 extern int mayanCycleCount;
+extern int batchSize;
+extern int batchTarget;
+extern int storedBatchSize;
 
 extern boolean encoderPressed;
 extern boolean encoderMoved;
 extern volatile boolean startPressed;
 extern volatile boolean stopPressed;
 
-extern String output;
-
 extern Menu::navRoot nav;
 
 extern StoredCase storedCases[10];
 
+extern TimingHistogram annealLateness;
+
 // function protos
 
 void annealStateMachine(void);
-float calcSteinhart(float);
+float thermistorTemp(long);
 void checkPowerSensors(boolean);
 void checkThermistors(boolean);
+void sensorsApply(const SensorSample &sample);
+uint8_t sensorsUpdate(void);
 void updateLCD(boolean full);
 void updateLCDState(void);
-void updateLCDSetPoint(boolean sendIt);
-void updateLCDPowerDisplay(boolean sendIt);
-void updateLCDTemps(boolean sendIt);
-void updateLCDTimer(boolean sendIt);
+void updateLCDSetPoint(void);
+void updateLCDPowerDisplay(void);
+void updateLCDTemps(void);
+void updateLCDTimer(void);
+void lcdBufReset(void);
+void lcdBufClear(void);
+void lcdBufPrint(uint8_t col, uint8_t row, const char *s);
+void lcdBufPrint(uint8_t col, uint8_t row, const __FlashStringHelper *fs);
+void lcdBufBacklight(uint8_t red, uint8_t green, uint8_t blue);
+void lcdBufFlush(unsigned long budget);
+boolean lcdBufPending(void);
 void eepromStartup(void); 
 void eepromCheckAnnealSetPoint(void);
 void eepromCheckDelaySetPoint(void);
@@ -302,6 +542,11 @@ void eepromCheckCaseDropSetPoint (void);
 void eepromStoreCase(int);
 void eepromStoreStartOnOpto(void);
 void eepromStoreMayanUseSD(void);
+void eepromCheckBatchSize(void);
+void eepromCheckDelayGovernor(void);
+void eepromCheckAnnealEnergy(void);
+uint16_t eepromGetLogSequence(void);
+void eepromStoreLogSequence(uint16_t);
 void mayanStateMachine(void);
 void mayanLCDWaitButton(boolean);
 void mayanLCDStartMayan(void);
@@ -314,7 +559,88 @@ void mayanLCDAbort(void);
 void mayanLCDLeaveAbort(void);
 void annealLogStartNewFile(void);
 void annealLogCloseFile(void);
-void annealLogWrite(String);
+void annealLogWrite(const char *s);
+void annealLogRunStart(uint16_t cycle);
+void annealLogSample(uint16_t timestamp, uint16_t amps, uint16_t volts);
+void annealLogRunEnd(uint16_t samples, uint16_t recommendation);
+void annealLogService(void);
+void annealLogFlush(void);
+boolean annealLogOpenText(const char *fileName, boolean &newFile);
+void annealLogBatch(const char *line);
+Print &annealLogPrint(void);
+
+// batch accounting - AnnealBatch.cpp
+void batchStart(void);
+void batchCaseDone(void);
+boolean batchComplete(void);
+void batchEnd(void);
+void batchClear(void);
+char *batchFormatStatus(char *buf);
+
+// thermal delay governor - AnnealGovernor.cpp
+void governorStart(void);
+unsigned long governorDelayMillis(void);
+
+// hardware abstraction - AnnealHAL.cpp
+void halBegin(void);
+void halAttachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+boolean halPinChangeBegin(uint8_t pin, void (*handler)(void));
+void halInductor(boolean on);
+void halInductorArm(unsigned long ms);
+void halInductorCutoff(void);
+boolean halInductorExpired(void);
+void halSolenoid(boolean open);
+boolean halCasePresent(uint8_t sensor = OPTO_CASE_DETECT);
+int halAnalogRead(uint8_t pin);
+int halAnalogReadISR(uint8_t pin);
+unsigned long halAnalogReadOversampled(uint8_t pin, uint8_t bits);
+unsigned long halAnalogReadOversampledISR(uint8_t pin, uint8_t bits);
+#ifdef _AP3_VARIANT_H_
+float halInternalTemp(void);
+#endif
+unsigned long halInductorOnTime(void);
+boolean halTickerBegin(unsigned long ms, void (*handler)(void));
+void halSleep(void);
+unsigned long halMillis(void);
+unsigned long halMicros(void);
+void halDelay(unsigned long ms);
+
+// cooperative scheduler - AnnealScheduler.cpp
+void schedRegister(SchedJob job, unsigned long period, uint8_t priority, void (*run)(void));
+void schedRestart(SchedJob job);
+boolean schedRun(void);
+boolean schedTimerPassed(Chrono &timer, unsigned long ms);
+void schedIdle(void);
+
+// case detect opto sensors - AnnealOpto.cpp
+void optoBegin(void);
+void optoUpdate(void);
+boolean optoPresent(uint8_t sensor, unsigned long &since);
+uint16_t optoArrivals(uint8_t sensor);
+
+// background sampler - AnnealSampler.cpp
+void samplerBegin(void);
+void samplerReset(void);
+boolean samplerRead(SensorSample &sample);
+void samplerEnergyArm(float joules);
+float samplerEnergyJoules(void);
+
+// timing statistics - AnnealStats.cpp
+void histogramReset(TimingHistogram &h);
+void histogramAdd(TimingHistogram &h, unsigned long value);
+unsigned long histogramMean(const TimingHistogram &h);
+unsigned long histogramPercentile(const TimingHistogram &h, uint8_t pct);
+void histogramPrint(Print &p, const __FlashStringHelper *label, const TimingHistogram &h);
+void annealRecordLateness(unsigned long onMicros);
+void annealDwellBegin(void);
+void annealDwellTrack(void);
+void annealDwellDump(void);
+void loopProfileStart(void);
+void loopProfileEnd(void);
+void loopProfileShow(void);
+#ifdef DEBUG_COSTMODEL
+void costModelCharge(unsigned long us);
+#endif
 
 
 #endif // _ANNEALER_CONTROL_H
@@ -81,13 +81,9 @@ Encoder encoder(ENCODER_A_PIN, ENCODER_B_PIN, ENCODER_BUTTON);
 
 
  /*
-  * TIMERS - Chrono can set up a metronome (replaces old Metro library) to establish
-  * a periodic time for accomplishing a task, based on milliseconds
+  * TIMERS - Timer is the stopwatch for the state machines' timed states. Periodic jobs
+  * go through the scheduler instead - see the jobs below, and AnnealScheduler.cpp
   */
-Chrono AnalogSensors; 
-Chrono AnnealPowerSensors;
-Chrono AnnealLCDTimer;
-Chrono LCDTimer;
 Chrono Timer; 
 
 /*
@@ -97,6 +93,11 @@ float Therm1Avg = 0;
 float Therm1Temp = 0;
 float Therm1TempHigh = 0;  // track highest temp we saw
 
+#ifdef THERM2_PIN
+float Therm2Temp = 0;
+float Therm2TempHigh = 0;
+#endif
+
 #ifdef _AP3_VARIANT_H_
 float internalTemp = 0;
 float internalTempHigh = 0;  // track highest temp we saw
@@ -118,6 +119,8 @@ boolean startOnOpto = false; // we'll use this once we have an optical case sens
 float annealSetPoint = (float) ANNEAL_TIME_DEFAULT / 100;  // plan to store this value as hundredths of seconds, multiplied by 100
 float delaySetPoint = (float) DELAY_DEFAULT / 100;         // same format - in this case, we start with a half second pause, just in case
 float caseDropSetPoint = (float) CASE_DROP_DELAY_DEFAULT / 100;
+float annealEnergySetPoint = 0.0;   // joules - 0 means anneal on time only
+float annealEnergyLast = 0.0;       // joules the last case actually got
 int encoderDiff = 0;
 
 volatile unsigned long startdebounceMicros = 0;
@@ -125,10 +128,6 @@ volatile unsigned long stopdebounceMicros = 0;
 
 boolean showedScreen = false;
 
-#ifdef DEBUG_LOOPTIMING
-unsigned long loopMillis = 0;
-#endif
-
 #ifdef DEBUG
 int temp = 0;
 #endif
@@ -146,8 +145,8 @@ int temp = 0;
 */
 
 void startPressedHandler(void) {
-  if ((long) (micros() - startdebounceMicros) >= DEBOUNCE_MICROS) {
-    startdebounceMicros = micros();
+  if ((long) (halMicros() - startdebounceMicros) >= DEBOUNCE_MICROS) {
+    startdebounceMicros = halMicros();
     startPressed = true;
   }
 }
@@ -159,46 +158,100 @@ void startPressedHandler(void) {
   */
 
 void stopPressedHandler(void) {
-  if ((long) (micros() - stopdebounceMicros) >= DEBOUNCE_MICROS) {
-    stopdebounceMicros = micros();
+  if ((long) (halMicros() - stopdebounceMicros) >= DEBOUNCE_MICROS) {
+    stopdebounceMicros = halMicros();
     stopPressed = true;
   }
 }
 
 
 
+/*
+ * lcdBudget
+ * 
+ * How much LCD time we can afford on this pass - strict while the inductor or trap door is
+ * running, or Mayan is sampling, and relaxed everywhere else.
+ */
+unsigned long lcdBudget(void) {
+  if (menuState == ANNEALING) {
+    switch (annealState) {
+      case START_ANNEAL:
+      case ANNEAL_TIMER:
+      case DROP_CASE:
+      case DROP_CASE_TIMER:
+        return LCD_BUDGET_STRICT;
+      default:
+        break;
+    }
+  }
+  else if (menuState == MAYAN) {
+    switch (mayanState) {
+      case START_MAYAN:
+      case MAYAN_TIMER:
+      case DROP_CASE_TIMER_MAYAN:
+        return LCD_BUDGET_STRICT;
+      default:
+        break;
+    }
+  }
+  return LCD_BUDGET_RELAXED;
+}
+
+
+/******************************************************
+ * SCHEDULER JOBS
+ * 
+ * Registered in setup(), and run from loop() outside
+ * the menu system - each one checks for itself whether
+ * it has anything to do in the current state
+ ******************************************************/
+
+void jobThermistors(void) {
+  checkThermistors(false);
+}
+
+// the normal screen refresh, for the annealing states that aren't timing critical
+void jobLCDRefresh(void) {
+  if (menuState != ANNEALING) return;
+
+  switch (annealState) {
+    case START_ANNEAL:
+    case ANNEAL_TIMER:
+    case DROP_CASE:
+      break;
+    default:
+      updateLCD(false);
+      break;
+  }
+}
+
+// while the inductor's on, just the timer and the power readouts - nothing else changes
+void jobAnnealTimer(void) {
+  if ((menuState == ANNEALING) && (annealState == ANNEAL_TIMER)) updateLCDTimer();
+}
+
+void jobAnnealPower(void) {
+  if ((menuState == ANNEALING) && (annealState == ANNEAL_TIMER)) updateLCDPowerDisplay();
+}
+
+
 /**************************************************************************************************
  * setup
  **************************************************************************************************/
 void setup() {
 
-  // Assign pin modes
-  pinMode(INDUCTOR_PIN, OUTPUT);
-  pinMode(SOLENOID_PIN, OUTPUT);
-  pinMode(START_PIN, INPUT_PULLUP);
-  pinMode(STOP_PIN, INPUT_PULLUP);
-  pinMode(LED_BUILTIN, OUTPUT);
-  pinMode(OPTO1_PIN, INPUT_PULLUP);
+  // Assign pin modes, set up the ADC, and make sure inductor board power is off, and
+  // the trap door is closed
+  halBegin();
 
-
-  // make sure inductor board power is off, and the trap door is closed
-  digitalWrite(INDUCTOR_PIN, LOW);
-  digitalWrite(SOLENOID_PIN, LOW);
-
-  attachInterrupt(digitalPinToInterrupt(START_PIN), startPressedHandler, FALLING);
-  attachInterrupt(digitalPinToInterrupt(STOP_PIN), stopPressedHandler, FALLING);
+  halAttachInterrupt(START_PIN, startPressedHandler, FALLING);
+  halAttachInterrupt(STOP_PIN, stopPressedHandler, FALLING);
 
   Serial.begin(115200); // something gets unhappy if we don't spin up Serial
   #ifdef DEBUG
     while (!Serial) ;
   #endif
 
-  #ifdef _AP3_VARIANT_H_
-    analogReadResolution(14); //Set ADC resolution to the highest value possible 
-  #else
-    analogReadResolution(10);
-  #endif
-
   #ifdef DEBUG
     #ifdef _AP3_VARIANT_H_
       Serial.println(F("DEBUG: ADC read resolution set to 14 bits"));
@@ -221,15 +274,43 @@ void setup() {
   nav.inputBurst=10; // helps responsiveness to the encoder knob
   nav.useUpdateEvent=true;
 
-  // set the display for high temps to be read-only
-  dataDisplayMenu[0].disable();
+  // set the data display fields to be read-only - everything but "Dump Dwell", "Loop Times",
+  // and the "<< Back" at the end. The dwell numbers are only there with ANNEAL_STATS
+  idx_t dataField = 0;
+  dataDisplayMenu[dataField++].disable(); // T1 High
   #ifdef _AP3_VARIANT_H_
-  dataDisplayMenu[1].disable();
+  dataDisplayMenu[dataField++].disable(); // Int High
   #endif
+  dataDisplayMenu[dataField++].disable(); // Late p50
+  dataDisplayMenu[dataField++].disable(); // Late p99
+  dataDisplayMenu[dataField++].disable(); // Late max
+  dataDisplayMenu[dataField++].disable(); // Energy
+  #ifdef ANNEAL_STATS
+  dataDisplayMenu[dataField++].disable(); // Wait p50
+  dataDisplayMenu[dataField++].disable(); // Anneal p50
+  dataDisplayMenu[dataField++].disable(); // Drop p50
+  dataDisplayMenu[dataField++].disable(); // Delay p50
+  #endif
+
+  // same for the loop timing numbers - everything but the state picker up top, and "<< Back"
+  for (idx_t loopField = 1; loopField <= 4; loopField++) {
+    loopTimesMenu[loopField].disable(); // Min, Mean, p99, Max
+  }
     
   // Initial temperature sensor baselines
   checkThermistors(true);
 
+  // and from here on, the sensors get read in the background
+  samplerBegin();
+  optoBegin();
+
+  // periodic jobs - lower numbers go first, when more than one is due
+  schedRegister(SCHED_LOG, LOG_PACE_MS, 0, annealLogService);
+  schedRegister(SCHED_ANNEAL_TIMER, ANNEAL_LCD_TIMER_INTERVAL, 1, jobAnnealTimer);
+  schedRegister(SCHED_ANNEAL_POWER, ANNEAL_POWER_INTERVAL, 2, jobAnnealPower);
+  schedRegister(SCHED_THERMISTORS, ANALOG_INTERVAL, 3, jobThermistors);
+  schedRegister(SCHED_LCD, LCD_UPDATE_INTERVAL, 4, jobLCDRefresh);
+
   // pull the intial settings from the EEPROM
   eepromStartup();
   
@@ -244,12 +325,12 @@ void setup() {
   // the Apollo3 CPU gets through some of the init code faster than the 
   // LCD controller is actually ready to receive it. 
   
-  if (! LCDTimer.hasPassed(LCD_STARTUP_INTERVAL) ) {
-    delay(LCD_STARTUP_INTERVAL - LCDTimer.elapsed());
+  if (halMillis() < LCD_STARTUP_INTERVAL) {
+    halDelay(LCD_STARTUP_INTERVAL - halMillis());
   } // clear to make first output to the LCD, now
 
-  lcd.setFastBacklight(WHITE);
-  lcd.clear();
+  lcdBufBacklight(WHITE);
+  lcdBufReset();
 
   // Show a banner, for now - might program this as a startup screen on the LCD later
   //
@@ -257,14 +338,12 @@ void setup() {
   //   CASE BURNER 5000
   // PREPARE FOR GLORY!!!
 
-  lcd.setCursor(2,1);
-  lcd.print(F("CASE BURNER 5000"));
-  lcd.setCursor(0,2);
-  lcd.print(F("PREPARE FOR GLORY!!!"));
-  delay(2000);
+  lcdBufPrint(2, 1, F("CASE BURNER 5000"));
+  lcdBufPrint(0, 2, F("PREPARE FOR GLORY!!!"));
+  lcdBufFlush(LCD_BUDGET_RELAXED);
+  halDelay(2000);
   
-  lcd.clear();
-  LCDTimer.restart();
+  lcdBufReset();
 
 
   #ifdef DEBUG
@@ -279,9 +358,7 @@ void setup() {
  **************************************************************************************************/
 void loop() {
 
-  #ifdef DEBUG_LOOPTIMING
-  loopMillis = millis();
-  #endif
+  loopProfileStart();
 
   if (nav.sleepTask) {  // if we're not in the ArduinoMenu system
 
@@ -292,11 +369,15 @@ void loop() {
       if (menuState == ANNEALING) {
         
         checkPowerSensors(true);
-        lcd.setFastBacklight(GREEN);
+        lcdBufBacklight(GREEN);
         updateLCD(true);
         eepromCheckAnnealSetPoint();
         eepromCheckDelaySetPoint();
         eepromCheckCaseDropSetPoint();
+        eepromCheckBatchSize();
+        eepromCheckDelayGovernor();
+        eepromCheckAnnealEnergy();
+        annealDwellBegin();
         
       }
       else if (menuState == MAYAN) {
@@ -316,6 +397,15 @@ void loop() {
     else if (menuState == MAYAN) {
       mayanStateMachine();
     }
+
+    // then whichever periodic job is up next - see AnnealScheduler.cpp
+    schedRun();
+
+    // whatever got drawn this pass goes out to the LCD now, as much as the budget allows -
+    // unless the state machine just handed the screen back to the menu system
+    if (menuState != MAIN_MENU) {
+      lcdBufFlush(lcdBudget());
+    }
     
   } // if (nav.sleepTask())
   else {
@@ -325,11 +415,12 @@ void loop() {
     
   }
 
-  #ifdef DEBUG_LOOPTIMING
-  if ((millis() - loopMillis) > 50) {
-    Serial.print(F("DEBUG: loop took "));
-    Serial.println(millis() - loopMillis);
+  loopProfileEnd();
+
+  // nothing due for a while? sleep until the next interrupt - after the profiler, so the 
+  // numbers are still just the work
+  if (menuState != MAIN_MENU) {
+    schedIdle();
   }
-  #endif
   
 } // loop()
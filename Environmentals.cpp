@@ -10,6 +10,7 @@
  **************************************************************************************************/
 
 #include "Annealer-Control.h"
+#include "AnnealThermistor.h"
 
 #ifdef DEBUG
 extern int temp;
@@ -19,33 +20,141 @@ extern int temp;
 int iterations = 0;
 #endif
 /*
- * calcSteinhart
+ * thermistorTemp
  * 
  * Arguments: 
- * input - generally a raw or smoothed value from analogRead.
+ * sixteenths - a raw or smoothed reading from the thermistor, in 1/16ths of an ADC count
  * 
- * Calculate a psuedo Steinhart-Hart based temperature value for our current
- * thermistor reading. Currently, we only have one thermistor in play, but in the
- * future, there may be more. If so, we should move most of this code to a function
- * that accepts inputting nominal temp, resistance, and beta values for each 
- * thermistor, and then have this one use whatever default we need it to use.
+ * Temperature, in degrees F, for a thermistor reading - looked up in the table from
+ * AnnealThermistor.h, and interpolated between entries. Carrying the reading in 1/16ths keeps
+ * the extra resolution the smoothing gives us, and it's all integer math until the very end.
+ */
+float thermistorTemp(long x) {
+  const long segment = THERM_LUT_STEP * 16L;
+  long below, above, step;
+
+  if (x < 0) x = 0;
+  if (x >= (RESOLUTION_MAX * 16L)) x = (RESOLUTION_MAX * 16L) - 1;
+
+  below = (int16_t) pgm_read_word(&ThermLUT::tenths[x / segment]);
+  above = (int16_t) pgm_read_word(&ThermLUT::tenths[(x / segment) + 1]);
+
+  // rounded, not truncated - the table runs downhill, and truncating would add most of a tenth
+  step = (above - below) * (x % segment);
+  step = (step + ((step < 0) ? -(segment / 2) : (segment / 2))) / segment;
+
+  return (below + step) * 0.1;
+}
+
+
+/*
+ * Sensor filters - the types are picked in Annealer-Control.h. Power has a separate set per 
+ * mode, so switching modes can't drag the other mode's smoothing along.
+ */
+AnnealAmpsFilter annealAmpsFilter;
+AnnealVoltsFilter annealVoltsFilter;
+MayanAmpsFilter mayanAmpsFilter;
+MayanVoltsFilter mayanVoltsFilter;
+Therm1Filter therm1Filter;
+#ifdef THERM2_PIN
+Therm2Filter therm2Filter;
+#endif
+
+// power filter output (sample sums, with FILTER_FRAC_BITS) to plain ADC counts
+#define FILTER_TO_COUNTS    (1.0 / ((float) POWER_SAMPLE_SCALE * (1L << FILTER_FRAC_BITS)))
+
+
+/*
+ * ampsFromCounts / voltsFromCounts
+ * 
+ * Power sensor conversions, from an average ADC reading (in single conversion counts).
+ */
+static float ampsFromCounts(float counts) {
+  float ampsRead = (((counts * (VREF / RESOLUTION_MAX)) - AMPS_ZERO_VOLTS) * AMPS_PER_VOLT);
+  return (ampsRead < 0) ? 0 : ampsRead;
+}
+
+static float voltsFromCounts(float counts) {
+  return counts * VOLTS_PER_RESOLUTION;
+}
+
+
+#ifdef DEBUG_MAYAN
+/*
+ * mayanFakePower
+ * 
+ * If we're debugging the MAYAN feature, feed it fake data that we can control, one step per 
+ * sample
+ */
+static void mayanFakePower(boolean reset) {
+  if (reset) {
+    amps = 0.0;
+    volts = 48.0;
+    iterations = 0;
+  }
+  else {
+    if (iterations < 200) { // steadily increase amps until 10 second mark
+      amps += 0.08;
+      volts = 45.2;
+    }
+    else if ((iterations >= 200) && (iterations < 210)) { // taper quickly
+      amps -= 0.12;
+    }
+    else {   // then more gradually
+      amps -= 0.03;
+    }
+    iterations++;
+  }
+}
+#endif // DEBUG_MAYAN
+
+
+/*
+ * sensorsApply
+ * 
+ * Fold one sample from the background sampler into amps, volts, and the thermistor readings -
+ * with whatever smoothing the current mode calls for.
+ */
+void sensorsApply(const SensorSample &sample) {
+
+  if (menuState == MAYAN) {
+    #ifdef DEBUG_MAYAN
+    mayanFakePower(false);
+    #else
+    mayanAmpsFilter.add(sample.amps);
+    mayanVoltsFilter.add(sample.volts);
+    amps = ampsFromCounts(mayanAmpsFilter.value() * FILTER_TO_COUNTS);
+    volts = voltsFromCounts(mayanVoltsFilter.value() * FILTER_TO_COUNTS);
+    #endif
+  }
+  else {
+    annealAmpsFilter.add(sample.amps);
+    annealVoltsFilter.add(sample.volts);
+    amps = ampsFromCounts(annealAmpsFilter.value() * FILTER_TO_COUNTS);
+    volts = voltsFromCounts(annealVoltsFilter.value() * FILTER_TO_COUNTS);
+  }
+
+  therm1Filter.add(sample.therm1);
+  Therm1Temp = thermistorTemp(therm1Filter.value() / (SAMPLER_SAMPLE_READS << (FILTER_FRAC_BITS - 4)));
+  if (Therm1Temp > Therm1TempHigh) {
+    Therm1TempHigh = Therm1Temp;
+  }
+}
+
+/*
+ * sensorsUpdate
  * 
- * The Steinhart equation expects all temperature values to be in degrees Kelvin,
- * so the 273.15 constant below converts to/from Centigrade. The last line converts *that*
- * to degrees Farenheit (easy to remove if you want Centigrade...)
+ * Apply everything the sampler has queued up since last time. Returns how many samples that was.
  */
-float calcSteinhart(float input) {
-  float output = 0.0;
-  output = (THERM_RESISTOR / ((RESOLUTION_MAX / input) - 1)); // this gives us measured resistance in ohms!
-  output = output / THERM_NOMINAL;
-  output = log(output);
-  output /= THERM_BETA;
-  output += 1.0 / (THERM_NOM_TEMP + 273.15);
-  output = 1.0 / output;
-  output -= 273.15; 
-  output = output * 1.8 + 32.0; 
-
-  return output;
+uint8_t sensorsUpdate(void) {
+  SensorSample sample;
+  uint8_t count = 0;
+
+  while (samplerRead(sample)) {
+    sensorsApply(sample);
+    count++;
+  }
+  return count;
 }
 
 
@@ -53,57 +162,42 @@ float calcSteinhart(float input) {
  * checkPowerSensors
  * 
  * Aggregating the code for voltage and current monitoring to a subroutine, as it's used
- * in a couple different places
+ * in a couple different places.
+ * 
+ * A reset takes a fresh, synchronous reading of both sensors and starts the smoothing over -
+ * otherwise, we just catch up on what the background sampler has for us.
  */
 void checkPowerSensors(boolean reset) {
 
-  int ampsCalc = 0;
+  #ifdef DEBUG_COSTMODEL
+  costModelCharge(COSTMODEL_POWER_MICROS);
+  #endif
+
+  if (!reset) {
+    sensorsUpdate();
+    return;
+  }
 
-  // if we're debugging the MAYAN feature, feed it fake data that we can control
   #ifdef DEBUG_MAYAN
   if (menuState == MAYAN) {
-    if (reset) {
-      amps = 0.0;
-      volts = 48.0;
-      iterations = 0;
-    }
-    else {
-      if (iterations < 200) { // steadily increase amps until 10 second mark
-        amps += 0.08;
-        volts = 45.2;
-      }
-      else if ((iterations >= 200) && (iterations < 210)) { // taper quickly
-        amps -= 0.12;
-      }
-      else {   // then more gradually
-        amps -= 0.03;
-      }
-      iterations++;
-    }
-    
+    mayanFakePower(true);
     return;
-    
   }
   #endif // DEBUG_MAYAN
 
-  
-  if (reset) {
-      amps = ( ( ( analogRead(CURRENT_PIN) / RESOLUTION_MAX * VREF ) - 1.0) / 100 );
-      if ( amps < 0 ) amps = 0;
-      volts = ( analogRead(VOLTAGE_PIN) * VOLTS_PER_RESOLUTION );
-  }
-  else {
-    ampsCalc = ( ( ( analogRead(CURRENT_PIN) / RESOLUTION_MAX * VREF ) - 1.0) / 100 );
-    if (ampsCalc < 0) ampsCalc = 0;
-    if (menuState == ANNEALING) {
-      amps = ( ( (1.0 - AMPS_SMOOTH_RATIO) * amps ) + (AMPS_SMOOTH_RATIO * ampsCalc) );
-      volts = ( (1.0 - VOLTS_SMOOTH_RATIO) * volts ) + (VOLTS_SMOOTH_RATIO * ( analogRead(VOLTAGE_PIN) * VOLTS_PER_RESOLUTION ) );
-    }
-    else if (menuState == MAYAN) {
-      amps = ( ( (1.0 - MAYAN_AMPS_SMOOTH_RATIO) * amps ) + (MAYAN_AMPS_SMOOTH_RATIO * ampsCalc) );
-      volts = ( (1.0 - MAYAN_VOLTS_SMOOTH_RATIO) * volts ) + (MAYAN_VOLTS_SMOOTH_RATIO * ( analogRead(VOLTAGE_PIN) * VOLTS_PER_RESOLUTION ) );
-    }
-  }
+  // start the filters off at one sample's worth, read the way the sampler does
+  uint32_t ampsSum = 0;
+  uint32_t voltsSum = 0;
+  for (int i = 0; i < SAMPLER_TICKS; i++) ampsSum += halAnalogReadOversampled(CURRENT_PIN, POWER_OVERSAMPLE_BITS);
+  for (int i = 0; i < SAMPLER_TICKS; i++) voltsSum += halAnalogReadOversampled(VOLTAGE_PIN, POWER_OVERSAMPLE_BITS);
+
+  annealAmpsFilter.reset(ampsSum);
+  annealVoltsFilter.reset(voltsSum);
+  mayanAmpsFilter.reset(ampsSum);
+  mayanVoltsFilter.reset(voltsSum);
+
+  amps = ampsFromCounts(ampsSum / (float) POWER_SAMPLE_SCALE);
+  volts = voltsFromCounts(voltsSum / (float) POWER_SAMPLE_SCALE);
 
 }
 
@@ -113,21 +207,21 @@ void checkThermistors(boolean reset) {
     for (int i=0; i<3; i++) {
       
       #ifdef DEBUG
-      temp = analogRead(THERM1_PIN);
+      temp = halAnalogRead(THERM1_PIN);
       Serial.print(F("DEBUG: THERM1_PIN read: ")); Serial.println(temp);
       Therm1Avg = Therm1Avg + temp;
 
         #ifdef _AP3_VARIANT_H_
-          temp = getInternalTemp();
+          temp = halInternalTemp();
           Serial.print(F("DEBUG: ADC_INTERNAL_TEMP read: ")); Serial.println(temp);
           internalTemp = internalTemp + temp ;
         #endif
       
       #else
-      Therm1Avg = Therm1Avg + analogRead(THERM1_PIN);
+      Therm1Avg = Therm1Avg + halAnalogRead(THERM1_PIN);
       
         #ifdef _AP3_VARIANT_H_
-        internalTemp = internalTemp + getInternalTemp();
+        internalTemp = internalTemp + halInternalTemp();
         #endif
       
       #endif
@@ -136,9 +230,18 @@ void checkThermistors(boolean reset) {
   
     // Average over the three readings...
     Therm1Avg /= 3;
-    Therm1Temp = calcSteinhart(Therm1Avg);    
+    therm1Filter.reset((uint32_t) ((Therm1Avg * SAMPLER_SAMPLE_READS) + 0.5));
+    Therm1Temp = thermistorTemp((long) (Therm1Avg * 16.0));    
     Therm1TempHigh = Therm1Temp;
 
+    // the second thermistor isn't on the sampler - it's only for the delay governor, and once
+    // every ANALOG_INTERVAL is plenty for that
+    #ifdef THERM2_PIN
+    therm2Filter.reset(halAnalogReadOversampled(THERM2_PIN, THERM2_OVERSAMPLE_BITS));
+    Therm2Temp = thermistorTemp(therm2Filter.value() >> (FILTER_FRAC_BITS + THERM2_OVERSAMPLE_BITS - 4));
+    Therm2TempHigh = Therm2Temp;
+    #endif
+
     #ifdef _AP3_VARIANT_H_
     internalTemp /= 3;
     internalTemp = internalTemp * 1.8 + 32; // convert to F
@@ -148,15 +251,18 @@ void checkThermistors(boolean reset) {
   }
   else {
     
-    Therm1Avg = ((1.0 - THERM_SMOOTH_RATIO) * Therm1Avg) + (THERM_SMOOTH_RATIO * analogRead(THERM1_PIN));
-    Therm1Temp = calcSteinhart(Therm1Avg); 
-    if (Therm1Temp > Therm1TempHigh) {
-      Therm1TempHigh = Therm1Temp;
-    }
+    // the thermistor comes in with the power sensors, from the sampler - see sensorsApply()
 
+    #ifdef THERM2_PIN
+    therm2Filter.add(halAnalogReadOversampled(THERM2_PIN, THERM2_OVERSAMPLE_BITS));
+    Therm2Temp = thermistorTemp(therm2Filter.value() >> (FILTER_FRAC_BITS + THERM2_OVERSAMPLE_BITS - 4));
+    if (Therm2Temp > Therm2TempHigh) {
+      Therm2TempHigh = Therm2Temp;
+    }
+    #endif
 
     #ifdef _AP3_VARIANT_H_
-      internalTemp = (((1.0 - INT_TEMP_SMOOTH_RATIO) * internalTemp) + (INT_TEMP_SMOOTH_RATIO * (getInternalTemp() * 1.8 + 32)) );
+      internalTemp = (((1.0 - INT_TEMP_SMOOTH_RATIO) * internalTemp) + (INT_TEMP_SMOOTH_RATIO * (halInternalTemp() * 1.8 + 32)) );
       if (internalTemp > internalTempHigh) {
         internalTempHigh = internalTemp;
       }
@@ -6,6 +6,7 @@
  * Inception: 05/18/2020
  * 
  * This file contains the routines used to update the LCD when it's under control of Mayan feature!
+ * Like the annealing screen, these all draw into the shadow framebuffer in AnnealLCDBuffer.cpp.
  * 
  * All of the externs below are in Annealer-Control.ino
  * 
@@ -13,12 +14,16 @@
 
  
 #include "Annealer-Control.h"
-#include <avr/dtostrf.h>
+#include "AnnealFormat.h"
 #include <Chrono.h>
 #include <SerLCD.h>
 
 #define BLANKLINE "                    "
 
+#define MAYAN_LCD_CYCLE       5,3   // 2 wide
+#define MAYAN_LCD_AREC        15,3  // 5 wide
+#define MAYAN_LCD_RECOMMEND   13,1  // 5 wide
+
 /*
  * 01234567890123456789  <-- column numbers, not printed!!
  *        MAYAN!
@@ -27,42 +32,26 @@
  * Cyc: XX  ARec: XX.XX  <-- after we've done a cycle!
  */
 
-char c[6];
-
 void mayanLCDWaitButton(boolean full) {
 
   if (full) {
-    lcd.clear();
-    lcd.setFastBacklight(WHITE);
-    lcd.setCursor(7,0);
-    lcd.print(F("MAYAN!"));
+    lcdBufReset();
+    lcdBufBacklight(WHITE);
+    lcdBufPrint(7, 0, F("MAYAN!"));
   }
 
-  lcd.setCursor(0,1);
-  lcd.print(F("START to begin      "));
-  lcd.setCursor(0,2);
-  lcd.print(F("STOP  to exit Mayan "));
+  lcdBufPrint(0, 1, F("START to begin      "));
+  lcdBufPrint(0, 2, F("STOP  to exit Mayan "));
 
-  lcd.setCursor(0,3);
   if (mayanCycleCount > 0) {
+    char c[6];
 
-    output = F("Cyc: ");
-    if (mayanCycleCount < 10) {
-      output.concat(" ");
-    }
-    output.concat(mayanCycleCount);
-  
-    output.concat(F("  ARec: "));
-
-    if (mayanAccRec < 10.0) {
-      output.concat(F(" "));
-    }
-    dtostrf(mayanAccRec, 5, 2, c);
-    output.concat(c);
-    lcd.print(output);
+    lcdBufPrint(0, 3, F("Cyc:      ARec:     "));
+    lcdBufPrint(MAYAN_LCD_CYCLE, formatScaled<2,0>(c, mayanCycleCount));
+    lcdBufPrint(MAYAN_LCD_AREC, formatFixed<5,2>(c, mayanAccRec));
   }
   else {
-    lcd.print(BLANKLINE);
+    lcdBufPrint(0, 3, BLANKLINE);
   }
   
 }
@@ -75,26 +64,17 @@ void mayanLCDWaitButton(boolean full) {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDStartMayan() {
-  lcd.setFastBacklight(RED);
-  lcd.setCursor(0,1);
-  lcd.print(F("   RUNNING  CYCLE  "));
-  lcd.setCursor(0,2);
-  lcd.print(F("   STOP to cancel   "));
+  lcdBufBacklight(RED);
+  lcdBufPrint(0, 1, F("   RUNNING  CYCLE  "));
+  lcdBufPrint(0, 2, F("   STOP to cancel   "));
   
   if (mayanCycleCount > 1) {
-    lcd.setCursor(5,3);
-    
-    output = "";
-    
-    if (mayanCycleCount < 10) {
-      output.concat(F(" "));
-    }
-    output.concat(mayanCycleCount);
-    lcd.print(output);
+    char c[3];
+
+    lcdBufPrint(MAYAN_LCD_CYCLE, formatScaled<2,0>(c, mayanCycleCount));
   }
   else {
-    lcd.setCursor(0,3);
-    lcd.print(F("Cyc:  1  ARec: 00.00"));
+    lcdBufPrint(0, 3, F("Cyc:  1  ARec: 00.00"));
   }
 }
 
@@ -106,9 +86,8 @@ void mayanLCDStartMayan() {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDCalculate() {
-  lcd.setFastBacklight(YELLOW);
-  lcd.setCursor(0,1);
-  lcd.print(F("    CALCULATING     "));
+  lcdBufBacklight(YELLOW);
+  lcdBufPrint(0, 1, F("    CALCULATING     "));
 }
 
 /*
@@ -119,8 +98,7 @@ void mayanLCDCalculate() {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDSaving() {
-  lcd.setCursor(0,1);
-  lcd.print(F("    SAVING DATA     "));
+  lcdBufPrint(0, 1, F("    SAVING DATA     "));
 
 }
 
@@ -132,36 +110,23 @@ void mayanLCDSaving() {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDWait() {
-  lcd.setFastBacklight(GREEN);
-  lcd.setCursor(0,1);
-
-  output = "";
-  output.concat(F("  Recommend: "));
+  char c[6];
 
-  dtostrf(mayanRecommendation, 5, 2, c);
-  output.concat(c);
-  output.concat(F("  "));
-  lcd.print(output);
+  lcdBufBacklight(GREEN);
+  lcdBufPrint(0, 1, F("  Recommend:        "));
+  lcdBufPrint(MAYAN_LCD_RECOMMEND, formatFixed<5,2>(c, mayanRecommendation));
 
-  lcd.setCursor(0,2);
-  lcd.print(F("  STOP to drop case "));
+  lcdBufPrint(0, 2, F("  STOP to drop case "));
 
-  lcd.setCursor(14,3); // new accumulated recommendation
-  output="";
-  if (mayanAccRec < 10.0) {
-    output.concat(F(" "));
-  }
-  dtostrf(mayanAccRec, 5, 2, c);
-  output.concat(c);
-  lcd.print(output);
+  // new accumulated recommendation
+  lcdBufPrint(MAYAN_LCD_AREC, formatFixed<5,2>(c, mayanAccRec));
   
 }
 
 
 void mayanLCDDropCase() {
   // just blank the "STOP to drop case" line
-  lcd.setCursor(0,2);
-  lcd.print(BLANKLINE);
+  lcdBufPrint(0, 2, BLANKLINE);
 }
 
 /*
@@ -172,12 +137,10 @@ void mayanLCDDropCase() {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDPauseWait() {
-  lcd.setFastBacklight(WHITE);
+  lcdBufBacklight(WHITE);
 
-  lcd.setCursor(0,1);
-  lcd.print(F("START for next case "));
-  lcd.setCursor(0,2);
-  lcd.print(F("STOP to end analysis"));
+  lcdBufPrint(0, 1, F("START for next case "));
+  lcdBufPrint(0, 2, F("STOP to end analysis"));
   
 }
 
@@ -189,18 +152,14 @@ void mayanLCDPauseWait() {
  * Cyc: XX  ARec: XX.XX
  */
 void mayanLCDAbort() {
-  lcd.setFastBacklight(ORANGE);
-  lcd.setCursor(6,0);
-  lcd.print(F("ABORTED!"));
-  lcd.setCursor(0,1);
-  lcd.print(F("START for next case "));
-  lcd.setCursor(0,2);
-  lcd.print(F("STOP to end analysis"));
+  lcdBufBacklight(ORANGE);
+  lcdBufPrint(6, 0, F("ABORTED!"));
+  lcdBufPrint(0, 1, F("START for next case "));
+  lcdBufPrint(0, 2, F("STOP to end analysis"));
 }
 
 // reprint the MAYAN! header
 void mayanLCDLeaveAbort() {
-  lcd.setFastBacklight(WHITE);
-  lcd.setCursor(6,0);
-  lcd.print(F(" MAYAN! "));
+  lcdBufBacklight(WHITE);
+  lcdBufPrint(6, 0, F(" MAYAN! "));
 }
@@ -5,105 +5,550 @@
  * Author: Dave Re
  * Inception: 05/18/2020
  * 
- * This file contains the "Mayan" mode state machine.
+ * This file contains the "Mayan" mode state machine - one enter/tick/exit set per MayanState,
+ * laid out in mayanStates[] for the engine in AnnealFSM.h.
  * 
- * All of the externs below are in Annealer-Control.ino
+ * The mode and settings it runs on (mayanState, amps and volts, the button flags) are globals
+ * from Annealer-Control.ino, declared in Annealer-Control.h.
  * 
  **************************************************************************************************/
 
 #include "Annealer-Control.h"
-#include <avr/dtostrf.h>
+#include "AnnealFormat.h"
+#include "AnnealFSM.h"
 #include <Chrono.h>
-#include <CircularBuffer.h>
 #include <Rencoder.h>
 
 #include <ctype.h>
-#include <vector>
-#include <iterator>
 
-#ifdef DEBUG_STATE
-  boolean stateChange = true;
-#endif
 
-#define CIRCULAR_BUFFER_LENGTH 5
-#define CYCLE_INTERVAL 50 // millis
+/*
+ * End point detection - the run is over when the current has clearly turned over. We track the
+ * least squares slope of amps over the last MAYAN_SLOPE_WINDOW samples, and:
+ * 
+ * - nothing counts until the run is MAYAN_MIN_RUNTIME old, so the inrush settling can't fool us
+ * - the detector only arms once the slope has been above MAYAN_SLOPE_RISING - we've seen it
+ *   climbing - and then fires when it's below -MAYAN_SLOPE_FALLING for MAYAN_SLOPE_CONFIRM 
+ *   samples in a row. One noisy sample can't end a run
+ * - with MAYAN_CONFIRM_VOLTS, the supply voltage can't be falling faster than 
+ *   MAYAN_VOLTS_SAG_LIMIT at the same time - a sagging supply pulls the current down with it,
+ *   and that's not the peak we're looking for
+ * 
+ * Rates are in hundredths (of amps or volts) per second, and they're set from the ADC, not by
+ * feel. A reading that wobbles by one count from sample to sample can fake a slope of at most
+ * (N^2/4) / (N(N^2-1)/12) counts per sample period, over an N point window - 16/42 of a count
+ * per 50ms sample, or about 7.6 counts a second. That's MAYAN_SLOPE_NOISE. Arming takes twice
+ * that, so noise alone never arms us, and firing takes the noise slope three samples running.
+ * One count is 100A/V * 2V / 16384, about 1.2 centi-amps, on the Apollo3, so that's roughly
+ * 19 to arm and 9 to fire there - and a 10-bit AVR board's counts are 40 times as coarse, so
+ * its thresholds are too.
+ */
+#define MAYAN_SLOPE_WINDOW      8       // samples - 400ms at CYCLE_INTERVAL
+#define MAYAN_MIN_RUNTIME       2000    // millis
+#define MAYAN_SLOPE_CONFIRM     3
+// #define MAYAN_CONFIRM_VOLTS
+
+// worst slope a one count wobble can fake, in counts per second
+#define MAYAN_SLOPE_SXX         ((MAYAN_SLOPE_WINDOW * (MAYAN_SLOPE_WINDOW * MAYAN_SLOPE_WINDOW - 1)) / 12.0)
+#define MAYAN_SLOPE_NOISE       (((MAYAN_SLOPE_WINDOW * MAYAN_SLOPE_WINDOW) / 4) / MAYAN_SLOPE_SXX * (1000.0 / CYCLE_INTERVAL))
+#define MAYAN_CENTIAMPS_COUNT   ((VREF / RESOLUTION_MAX) * AMPS_PER_VOLT * 100.0)
+#define MAYAN_CENTIVOLTS_COUNT  (VOLTS_PER_RESOLUTION * 100.0)
+
+#define MAYAN_SLOPE_RISING      ((int32_t) ((2 * MAYAN_SLOPE_NOISE * MAYAN_CENTIAMPS_COUNT) + 0.5))
+#define MAYAN_SLOPE_FALLING     ((int32_t) ((MAYAN_SLOPE_NOISE * MAYAN_CENTIAMPS_COUNT) + 0.5))
+#define MAYAN_VOLTS_SAG_LIMIT   ((int32_t) ((2 * MAYAN_SLOPE_NOISE * MAYAN_CENTIVOLTS_COUNT) + 0.5))
+#define CYCLE_INTERVAL SAMPLER_PERIOD_MS // millis - one data point per sample
 #define mayanF 0.48
 #define mayanK -0.016
+#define MAYAN_LINE_LENGTH 40 // "cycle,timestamp,amps,volts" - plenty of room
+
+/*
+ * Mayan data points
+ * 
+ * Each data point is packed down to six bytes - a 16-bit millisecond offset from the start of
+ * the run, and amps and volts in hundredths. We don't hold on to the run: each point goes to the
+ * log as it comes in, and the peak is tracked as we go. So the recommendation is ready the moment
+ * the detector fires, and CALCULATE has nothing left to search. It's the same peak the old scan
+ * found - the first sample with the highest amps - so mayanF and mayanK still mean what they did.
+ * 
+ * Overflow: if a run goes MAYAN_MAX_SAMPLES points without the slope check calling it done, we
+ * end the run right there, same as a normal finish - no peak in MAYAN_MAX_SAMPLES * 
+ * CYCLE_INTERVAL is already far longer than any case should take.
+ */
+#define MAYAN_MAX_SAMPLES 600 // 30 seconds at CYCLE_INTERVAL
 
-using namespace std;
+static_assert((unsigned long) MAYAN_MAX_SAMPLES * CYCLE_INTERVAL < 65536UL, "Mayan timestamps must fit in 16 bits");
 
 struct MayanDataPoint {
-  unsigned int timestamp = 0;
-  float dpAmps = 0.0;
-  float dpVolts =0.0;
+  uint16_t timestamp;   // milliseconds since START_MAYAN
+  uint16_t amps;        // hundredths
+  uint16_t volts;       // hundredths
 };
 
-boolean mayanScreenUpdate = false;
 boolean mayanUseSD = true;
-int mayanStartMillis = 0;
-int mayanCurrentMillis = 0;
+unsigned long mayanStartMillis = 0;
+unsigned long mayanCurrentMillis = 0;
 int mayanLoopCount = 0;
 int mayanCycleCount = 0;
 float mayanAccRec = 0.0; // accumulated recommendation based on 1 or more runs
 float mayanRecommendation = 0.0;
 float lastMayanRecommendation = 0.0;
 
-CircularBuffer<float, CIRCULAR_BUFFER_LENGTH> ampsBuffer;
+SlopeWindow<MAYAN_SLOPE_WINDOW> mayanAmpsSlope;
+#ifdef MAYAN_CONFIRM_VOLTS
+SlopeWindow<MAYAN_SLOPE_WINDOW> mayanVoltsSlope;
+#endif
+boolean mayanSlopeArmed = false;
+uint8_t mayanSlopeFalling = 0;    // samples in a row past the falling threshold
 
-vector<MayanDataPoint*> mayanDataPoints;
-MayanDataPoint *newdp;
+MayanDataPoint mayanLastPoint;      // newest
+MayanDataPoint mayanPeak;
+uint16_t mayanDataCount = 0;
 
-#ifdef DEBUG_MAYAN
-void mayanPrintDataToSerial() {
 
-  std::vector<MayanDataPoint*>::size_type i, sz;
-  sz = mayanDataPoints.size();
-  char c[6];
-  
-  Serial.println(F("MAYAN data dump"));
-
-  for (i = 0; i < sz; i++) {
-    output = "";
-    output.concat(mayanDataPoints[i]->timestamp);
-    output.concat(F(","));
-    dtostrf(mayanDataPoints[i]->dpAmps, 5, 2, c);
-    output.concat(c);
-    output.concat(F(","));
-    dtostrf(mayanDataPoints[i]->dpVolts, 5, 2, c);
-    output.concat(c);
-    Serial.println(output);
+// hundredths, clamped to what fits in 16 bits
+static uint16_t mayanCenti(float value) {
+  if (value <= 0.0) return 0;
+  if (value >= 655.35) return 65535;
+  return (uint16_t) ((value * 100.0) + 0.5);
+}
+
+/*
+ * mayanFormatSample
+ * 
+ * Write "timestamp,amps,volts" for one data point into p, and return a pointer to the null
+ * at the end. Needs 24 chars, worst case.
+ */
+char *mayanFormatSample(char *p, MayanDataPoint *dp) {
+  p = formatUnsigned(p, dp->timestamp);
+  *p++ = ',';
+  p = formatScaled<5,2>(p, dp->amps) + 5;
+  *p++ = ',';
+  p = formatScaled<5,2>(p, dp->volts) + 5;
+  return p;
+}
+
+/*
+ * mayanAddDataPoint
+ * 
+ * Take the current amps and volts as the next data point, and keep the peak up to date. Returns
+ * false if the run is already MAYAN_MAX_SAMPLES long.
+ */
+boolean mayanAddDataPoint(unsigned long timestamp) {
+  MayanDataPoint dp;
+
+  if (mayanDataCount >= MAYAN_MAX_SAMPLES) return false;
+
+  dp.timestamp = timestamp;
+  dp.amps = mayanCenti(amps);
+  dp.volts = mayanCenti(volts);
+
+  // first highest wins, on a tie
+  if ((mayanDataCount == 0) || (dp.amps > mayanPeak.amps)) {
+    mayanPeak = dp;
   }
 
-  Serial.println(F(""));
-  
+  mayanLastPoint = dp;
+  mayanDataCount++;
+
+  return true;
 }
-#endif
 
-void mayanSaveDataToSD() {
-  std::vector<MayanDataPoint*>::size_type i, sz;
-  sz = mayanDataPoints.size();
-  char c[6];
+/*
+ * mayanCalcRecommendation
+ * 
+ * LR88's algorithm, from the peak time
+ */
+void mayanCalcRecommendation(void) {
+  float timeTenthsSeconds = (float) mayanPeak.timestamp / 100.0;
+
+  mayanRecommendation = (timeTenthsSeconds * (mayanF + mayanK * (timeTenthsSeconds-90.0) * 0.1)) / 10.0;
+
+  #ifdef DEBUG_MAYAN
+  char line[MAYAN_LINE_LENGTH];
+  Serial.print(F("MAYAN: peak ")); 
+  mayanFormatSample(line, &mayanPeak);
+  Serial.print(line);
+  Serial.print(F(" of ")); Serial.print(mayanDataCount);
+  Serial.print(F(" points, at ")); Serial.print(timeTenthsSeconds * 100.0);
+  Serial.println(F("ms"));
+  #endif
+}
+
+/*
+ * mayanDetectorReset / mayanPeakPassed
+ * 
+ * The end point detector - see the notes up top. mayanPeakPassed() takes each sample's amps and
+ * volts, in hundredths, and returns true once the run is done.
+ */
+void mayanDetectorReset(void) {
+  mayanAmpsSlope.reset();
+  #ifdef MAYAN_CONFIRM_VOLTS
+  mayanVoltsSlope.reset();
+  #endif
+  mayanSlopeArmed = false;
+  mayanSlopeFalling = 0;
+}
+
+boolean mayanPeakPassed(unsigned long elapsed, uint16_t centiAmps, uint16_t centiVolts) {
+  mayanAmpsSlope.add(centiAmps);
+  #ifdef MAYAN_CONFIRM_VOLTS
+  mayanVoltsSlope.add(centiVolts);
+  #else
+  (void) centiVolts;
+  #endif
+
+  if ((elapsed < MAYAN_MIN_RUNTIME) || !mayanAmpsSlope.full()) return false;
+
+  if (mayanAmpsSlope.slopeAbove(MAYAN_SLOPE_RISING, CYCLE_INTERVAL)) {
+    mayanSlopeArmed = true;
+  }
+
+  if (mayanSlopeArmed && mayanAmpsSlope.slopeBelow(-MAYAN_SLOPE_FALLING, CYCLE_INTERVAL)
+      #ifdef MAYAN_CONFIRM_VOLTS
+      && !mayanVoltsSlope.slopeBelow(-MAYAN_VOLTS_SAG_LIMIT, CYCLE_INTERVAL)
+      #endif
+      ) {
+    mayanSlopeFalling++;
+  }
+  else {
+    mayanSlopeFalling = 0;
+  }
+
+  #ifdef DEBUG_MAYAN
+  Serial.print(F("MAYAN: slope numerator ")); Serial.print(mayanAmpsSlope.numerator());
+  Serial.print(F(" armed ")); Serial.print(mayanSlopeArmed);
+  Serial.print(F(" falling ")); Serial.println(mayanSlopeFalling);
+  #endif
+
+  return (mayanSlopeFalling >= MAYAN_SLOPE_CONFIRM);
+}
+
+
+/*
+ * mayanLogDataPoint
+ * 
+ * Queue the newest data point for the log - it streams out to the card while the run is still
+ * going.
+ */
+void mayanLogDataPoint(void) {
+  if (!mayanUseSD || (mayanDataCount == 0)) return;
+
+  annealLogSample(mayanLastPoint.timestamp, mayanLastPoint.amps, mayanLastPoint.volts);
+}
+
+/*
+ * mayanSaveTrailerToSD
+ * 
+ * The samples are already on their way to the card - all that's left is the trailer for the
+ * case, and a sync.
+ */
+void mayanSaveTrailerToSD() {
 
   #ifdef DEBUG
   Serial.println(F("DEBUG: MAYAN: Saving data to SD card!"));
   #endif
 
-  for (i = 0; i < sz; i++) {
-    output = "";
-    output.concat(mayanCycleCount);
-    output.concat(F(","));
-    output.concat(mayanDataPoints[i]->timestamp);
-    output.concat(F(","));
-    dtostrf(mayanDataPoints[i]->dpAmps, 5, 2, c);
-    output.concat(c);
-    output.concat(F(","));
-    dtostrf(mayanDataPoints[i]->dpVolts, 5, 2, c);
-    output.concat(c);
-    annealLogWrite(output);
+  annealLogRunEnd(mayanDataCount, mayanCenti(mayanRecommendation));
+  annealLogFlush();
+  
+}
+
+/*
+ * mayanEndAnalysis
+ * 
+ * Stop was pressed between cases - close out the log and start the averages over
+ */
+static void mayanEndAnalysis(void) {
+  if (mayanUseSD) {
+    annealLogCloseFile(); // keeps whatever streamed out, even after an abort
+  }
+
+  mayanStartMillis = 0;
+  mayanCurrentMillis = 0;
+  mayanLoopCount = 0;
+  mayanCycleCount = 0;
+  mayanAccRec = 0.0;
+  mayanRecommendation = 0.0;
+}
+
+
+  ////////////////////////////////
+  // WAIT_BUTTON_MAYAN
+  //
+  // Wait for the start button - or
+  // stop, to go back to the menus.
+  // The screen gets drawn when we
+  // come in from the menu, and by
+  // whichever state sent us here
+  ////////////////////////////////
+
+static uint8_t mayanWaitButtonTick(void) {
+  if (stopPressed) {
+    #ifdef DEBUG
+    Serial.println(F("DEBUG: MAYAN: Stop Pressed in WAIT_BUTTON_MAYAN"));
+    #endif
+    
+    lcdBufBacklight(WHITE);
+    lcdBufFlush(LCD_COST_BACKLIGHT); // just the backlight - the menu owns the screen now
+    nav.idleOff();
+    menuState = MAIN_MENU;
+    showedScreen = false;
+    (void) encoder.clear(); // clear our flags
+    stopPressed = false;
+    startPressed = false;
+  }
+  else if (startPressed) {
+    startPressed = false;
+    return START_MAYAN;
+  }
+
+  return WAIT_BUTTON_MAYAN;
+}
+
+
+  ////////////////////////////////
+  // START_MAYAN
+  //
+  // Start the analysis, and the
+  // inductor
+  // 
+  // This is a single cycle state
+  ////////////////////////////////
+
+static void mayanStartEnter(void) {
+  mayanLCDStartMayan();
+
+  mayanDetectorReset();
+  mayanDataCount = 0;
+  
+  // if Cycle count is 0, open a new file
+  if ((mayanCycleCount == 0) && mayanUseSD) { // start a new file
+     annealLogStartNewFile();  
   }
   
+  mayanLoopCount = 1;
+  mayanCycleCount++;
+
+  checkPowerSensors(true); // reset our amps/volts readings
+  if (mayanUseSD) {
+    annealLogRunStart(mayanCycleCount);
+  }
+  mayanAddDataPoint(0);
+  mayanLogDataPoint();
+  samplerReset(); // samples from here on are all from this run
+  mayanStartMillis = halMillis();
+  
+  halInductor(true);
+}
+
+static uint8_t mayanStartTick(void) {
+  return MAYAN_TIMER;
+}
+
+
+  ////////////////////////////////
+  // MAYAN_TIMER
+  //
+  // Keep track of the environmentals
+  // and stop the process at the appropriate
+  // time
+  ////////////////////////////////
+
+static uint8_t mayanTimerTick(void) {
+  // the sampler hands us a sample every CYCLE_INTERVAL, evenly spaced and timestamped when it
+  // was taken, however long the rest of loop() took - and each one is a data point
+
+  SensorSample sample;
+
+  while (samplerRead(sample)) {
+    mayanLoopCount++;
+    mayanCurrentMillis = sample.timestamp;
+
+    #ifdef DEBUG_MAYAN
+    Serial.print(F("MAYAN: Loop Count ")); Serial.println(mayanLoopCount);
+    #endif
+    
+    sensorsApply(sample);
+
+    // save our data point - if we're out of room, this run is over
+    boolean stored = mayanAddDataPoint(mayanCurrentMillis - mayanStartMillis);
+    if (stored) mayanLogDataPoint();
+
+    // are we done? 
+    if (mayanPeakPassed(mayanCurrentMillis - mayanStartMillis, mayanCenti(amps), mayanCenti(volts)) || !stored) {
+      halInductor(false);
+      mayanCalcRecommendation();
+      return CALCULATE;
+    }
+  }
+
+  return MAYAN_TIMER;
+}
+
+
+  ////////////////////////////////
+  // CALCULATE
+  //
+  // Take the results from the run,
+  // and make a timing recommendation
+  // 
+  // This is a single cycle state
+  ////////////////////////////////
+
+static void mayanCalculateEnter(void) {
+  mayanLCDCalculate();
+
+  // mayanRecommendation was worked out in MAYAN_TIMER, as soon as the run ended
+  mayanAccRec = ( (mayanAccRec * (float) (mayanCycleCount - 1)) + mayanRecommendation) / mayanCycleCount;
+
+  lastMayanRecommendation = mayanAccRec;
+}
+
+static uint8_t mayanCalculateTick(void) {
+  return SAVE_DATA;
+}
+
+
+  ////////////////////////////////
+  // SAVE_DATA
+  //
+  // Finish up the log for this case
+  // 
+  // This is a single cycle state
+  ////////////////////////////////
+
+static void mayanSaveDataEnter(void) {
+  mayanLCDSaving();
+  lcdBufFlush(LCD_BUDGET_RELAXED); // get the message up before we tie things up writing to the card
+          
+  // if we don't care about saving the data, move on
+  if (mayanUseSD) {
+    mayanSaveTrailerToSD();
+  }
+}
+
+static uint8_t mayanSaveDataTick(void) {
+  return WAIT_DROP_CASE;
+}
+
+
+  ////////////////////////////////
+  // WAIT_DROP_CASE
+  //
+  // Show the recommendation, and
+  // wait for the user to press
+  // a button to drop the case
+  ////////////////////////////////
+
+static void mayanWaitDropEnter(void) {
+  mayanLCDWait();
+}
+
+static uint8_t mayanWaitDropTick(void) {
+  if (!(stopPressed || startPressed)) return WAIT_DROP_CASE;
+
+  stopPressed = false;
+  startPressed = false;
+  return DROP_CASE_TIMER_MAYAN;
+}
+
+
+  ////////////////////////////////
+  // DROP_CASE_TIMER_MAYAN
+  //
+  // Open the trap door, and close
+  // it again at the right time
+  ////////////////////////////////
+
+static void mayanDropEnter(void) {
+  mayanLCDDropCase();
+  halSolenoid(true);
+  Timer.restart();
+}
+
+static uint8_t mayanDropTick(void) {
+  return schedTimerPassed(Timer, (int) caseDropSetPoint * 1000) ? PAUSE_WAIT : DROP_CASE_TIMER_MAYAN;
+}
+
+static void mayanDropExit(void) {
+  halSolenoid(false);
+}
+
+
+  ////////////////////////////////
+  // PAUSE_WAIT
+  //
+  // Wait for user to proceed while
+  // results are displayed for them
+  // 
+  // Start or stop goes back to
+  // WAIT_BUTTON_MAYAN, and it's left
+  // pressed, so that's where it
+  // takes effect
+  ////////////////////////////////
+
+static void mayanPauseEnter(void) {
+  mayanLCDPauseWait();
+}
+
+static uint8_t mayanPauseTick(void) {
+  if (stopPressed) { // we're ending this cycle 
+    mayanEndAnalysis();
+    return WAIT_BUTTON_MAYAN;
+  }
+  if (startPressed) { // going to another case in this cycle
+    return WAIT_BUTTON_MAYAN;
+  }
+  return PAUSE_WAIT;
+}
+
+
+  ////////////////////////////////
+  // ABORTED
+  //
+  // Everything's off - ask how to
+  // proceed, same as PAUSE_WAIT
+  ////////////////////////////////
+
+static void mayanAbortedEnter(void) {
+  halInductor(false);
+  halSolenoid(false);
+  mayanLCDAbort();
 }
 
+static uint8_t mayanAbortedTick(void) {
+  if (stopPressed) { // we're ending this cycle 
+    mayanEndAnalysis();
+    return WAIT_BUTTON_MAYAN;
+  }
+  if (startPressed) { // going to another case in this cycle
+    return WAIT_BUTTON_MAYAN;
+  }
+  return ABORTED;
+}
+
+static void mayanAbortedExit(void) {
+  mayanLCDLeaveAbort();
+}
+
+
+// in MayanState order
+static const FsmState mayanStates[MAYAN_STATES] = {
+  { FSM_NAME("WAIT_BUTTON_MAYAN"),     NULL,                mayanWaitButtonTick, NULL             },
+  { FSM_NAME("START_MAYAN"),           mayanStartEnter,     mayanStartTick,      NULL             },
+  { FSM_NAME("MAYAN_TIMER"),           NULL,                mayanTimerTick,      NULL             },
+  { FSM_NAME("CALCULATE"),             mayanCalculateEnter, mayanCalculateTick,  NULL             },
+  { FSM_NAME("SAVE_DATA"),             mayanSaveDataEnter,  mayanSaveDataTick,   NULL             },
+  { FSM_NAME("WAIT_DROP_CASE"),        mayanWaitDropEnter,  mayanWaitDropTick,   NULL             },
+  { FSM_NAME("DROP_CASE_TIMER_MAYAN"), mayanDropEnter,      mayanDropTick,       mayanDropExit    },
+  { FSM_NAME("PAUSE_WAIT"),            mayanPauseEnter,     mayanPauseTick,      NULL             },
+  { FSM_NAME("ABORTED"),               mayanAbortedEnter,   mayanAbortedTick,    mayanAbortedExit }
+};
+
+static StateMachine<MayanState, MAYAN_STATES> mayanFsm(mayanStates, mayanState);
+
+
 void mayanStateMachine() {
 
     ///////////////////////////////////////////////////////////////////////
@@ -135,10 +580,6 @@ void mayanStateMachine() {
           Serial.println(F("DEBUG: start button pressed"));
           #endif
           
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
           break;
 
         default:
@@ -163,11 +604,6 @@ void mayanStateMachine() {
           break;
 
         default:
-          digitalWrite(INDUCTOR_PIN, LOW);
-          digitalWrite(LED_BUILTIN, LOW);
-          digitalWrite(SOLENOID_PIN, LOW);
-          mayanState = ABORTED;
-          mayanScreenUpdate = true;
           startPressed = false;
           stopPressed = false;
           encoderPressed = false;
@@ -175,425 +611,25 @@ void mayanStateMachine() {
           #ifdef DEBUG
           Serial.println(F("DEBUG: stop button pressed - Mayan cycle aborted"));
           #endif
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
+
+          mayanFsm.go(ABORTED); // switches everything off
           break;
           
         } // switch(mayaState)
         
       }
     
-      if (AnalogSensors.hasPassed(ANALOG_INTERVAL, true)) {   // Note - the boolean restarts the timer for us
-      
-        checkThermistors(false);
-        
-      } // if (AnalogSensors...
-      
-    ////////////////////////////////////////////////////////
-    // Basic state machine for the Mayan cycle
-    ////////////////////////////////////////////////////////
-  
-
-  
-    switch(mayanState) {
-  
-      ////////////////////////////////
-      // WAIT_BUTTON_MAYAN
-      //
-      // Wait for the start button
-      // 
-      ////////////////////////////////
-      case WAIT_BUTTON_MAYAN: {
-        #ifdef DEBUG_STATE
-          if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter WAIT_BUTTON_MAYAN")); stateChange = false; }
-        #endif
-
-        // need to update the LCD in some fashion, here, on entry ("press button to start")
-        if (mayanScreenUpdate) {
-          mayanLCDWaitButton(false);
-          mayanScreenUpdate = false;
-        }
-        
-        if (stopPressed) {
-          #ifdef DEBUG
-          Serial.println(F("DEBUG: MAYAN: Stop Pressed in WAIT_BUTTON_MAYAN"));
-          #endif
-          
-          lcd.setFastBacklight(255, 255, 255);
-          nav.idleOff();
-          menuState = MAIN_MENU;
-          showedScreen = false;
-          (void) encoder.clear(); // clear our flags
-          stopPressed = false;
-          startPressed = false;
-        }
-        else if (startPressed) {
-          mayanState = START_MAYAN;
-          startPressed = false;
-          
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-        }
-        
-        break;
-      }
-  
-  
-
-  
-      ////////////////////////////////
-      // START_MAYAN
-      //
-      // Initial state change to start
-      // the analysis.
-      // 
-      // This is a single cycle state
-      ////////////////////////////////
-  
-      case START_MAYAN: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter START_MAYAN")); stateChange = false; }
-        #endif
-
-        mayanLCDStartMayan();
-        
-        mayanState = MAYAN_TIMER;
-
-        ampsBuffer.clear();
-        mayanDataPoints.clear();
-        
-        checkPowerSensors(true); // reset our amps/volts readings
-        ampsBuffer.push(amps);
-
-        newdp = new MayanDataPoint;
-        newdp->timestamp = 0;
-        newdp->dpAmps = amps;
-        newdp->dpVolts = volts;
-        mayanDataPoints.push_back(newdp);
-
-        // if Cycle count is 0, open a new file
-        if ((mayanCycleCount == 0) && mayanUseSD) { // start a new file
-           annealLogStartNewFile();  
-        }
-        
-        mayanLoopCount = 1;
-        mayanCycleCount++;
-        mayanStartMillis = millis();
-        
-        digitalWrite(INDUCTOR_PIN, HIGH);
-        digitalWrite(LED_BUILTIN, HIGH);
- 
-        
-        #ifdef DEBUG_STATE
-        stateChange = true;
-        #endif
-        
-        break;
-      }
- 
-      ////////////////////////////////
-      // MAYAN_TIMER
-      //
-      // Keep track of the environmentals
-      // and stop the process at the appropriate
-      // time
-      ////////////////////////////////
-  
-      case MAYAN_TIMER: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter MAYAN_TIMER")); stateChange = false; }
-        #endif
-
-        // on the Artemis, analogRead appears to take .08 milliseconds - two reads take about .15 milliseconds
-        // some of that timing has to do with logic around the test code, as well. These are very fast.
-
-        mayanCurrentMillis = millis();
-
-        if ( ((mayanCurrentMillis - mayanStartMillis) / CYCLE_INTERVAL) > mayanLoopCount) {
-          mayanLoopCount++;
-
-          #ifdef DEBUG_MAYAN
-          Serial.print(F("MAYAN: Loop Count ")); Serial.println(mayanLoopCount);
-          #endif
-          
-          checkPowerSensors(false);
-          ampsBuffer.push(amps); // push current amps to circular buffer to examine slope
-
-          // save our data point
-          newdp = new MayanDataPoint;
-          newdp->timestamp = mayanCurrentMillis - mayanStartMillis;
-          newdp->dpAmps = amps;
-          newdp->dpVolts = volts;
-          mayanDataPoints.push_back(newdp);
-
-          // are we done? 
-          // ideally, we'd be tracking the slope of the curve described by amps over time
-          // For our purposes, we can shortcut that, and just compare current amps to 
-          // a past value and see if we're lower. We're actually looking BUFLEN * CYCLE_INTERVAL
-          // milliseconds back. amps is already smoothed a bit, too, so hopefully, we're not 
-          // jumping the gun, here
-
-          // this algorithm can likely be improved
-
-          #ifdef DEBUG_MAYAN
-          Serial.print(F("MAYAN: ampsBuffer.last = ")); Serial.print(ampsBuffer.last()); Serial.print(F(" ampsBuffer.first = ")); Serial.println(ampsBuffer.first());
-          #endif
-          
-          if ((ampsBuffer.last() - ampsBuffer.first()) < 0.0) {
-            digitalWrite(INDUCTOR_PIN, LOW);
-            digitalWrite(LED_BUILTIN, LOW);
-            
-            mayanState = CALCULATE;
-
-            #ifdef DEBUG_STATE
-            stateChange = true;
-            #endif
-          }
-        }
-        break;
+      // START_MAYAN and MAYAN_TIMER take their samples one at a time - everywhere else, just 
+      // catch up
+      if ((mayanState != START_MAYAN) && (mayanState != MAYAN_TIMER)) {
+        sensorsUpdate();
       }
 
-      ////////////////////////////////
-      // CALCULATE
-      //
-      // Take the results from the run,
-      // and make a timing recommendation
-      ////////////////////////////////
-
-      case CALCULATE: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter CALCULATE")); stateChange = false; }
-        #endif
-        
-        // after running calculations, we advance to the next state
-        // need to update the LCD appropriately and ensure that
-        // we show the results for long enough, until the user
-        // chooses to proceed
-        mayanLCDCalculate();
-
-        float highestAmps = 0;
-
-        std::vector<MayanDataPoint*>::size_type highestIndex = 0;
-        std::vector<MayanDataPoint*>::size_type i;
-        for (i = 0; i < mayanDataPoints.size(); i++) {
-          if (mayanDataPoints[i]->dpAmps > highestAmps) {
-            highestAmps = mayanDataPoints[i]->dpAmps;
-            highestIndex = i; 
-          }
-        }
-
-        // use LR88's algorithm here - 
-        float timeTenthsSeconds = (float) mayanDataPoints[highestIndex]->timestamp / 100.0;
-        mayanRecommendation = (timeTenthsSeconds * (mayanF + mayanK * (timeTenthsSeconds-90.0) * 0.1)) / 10.0;
-
-        mayanAccRec = ( (mayanAccRec * (float) (mayanCycleCount - 1)) + mayanRecommendation) / mayanCycleCount;
-
-        lastMayanRecommendation = mayanAccRec;
-        
-        // show recommendation on the LCD
-
-        mayanState = SAVE_DATA;
-        
-        #ifdef DEBUG_STATE
-        stateChange = true;
-        #endif
-        
-        break;
-      }
-
-      ////////////////////////////////
-      // SAVE_DATA
-      //
-      // Save all the data to SD
-      ////////////////////////////////
-
-      case SAVE_DATA: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter SAVE_DATA")); stateChange = false; }
-        #endif
-        
-        mayanLCDSaving();
-                
-        // if we don't care about saving the data, move on
-        if (mayanUseSD) {
-          mayanSaveDataToSD();
-        }
-
-        #ifdef DEBUG_MAYAN
-        mayanPrintDataToSerial();
-        #endif
- 
-        mayanState = WAIT_DROP_CASE;
-
-        #ifdef DEBUG_STATE
-        stateChange = true;
-        #endif
-        
-        break;
-      }
       
-      ////////////////////////////////
-      // WAIT_DROP_CASE
-      //
-      // Wait for the user to press
-      // a button to drop the
-      // case, then proceed
-      ////////////////////////////////
-   
-      case WAIT_DROP_CASE: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter WAIT_DROP_CASE")); stateChange = false; }
-        #endif
-
-        mayanLCDWait();
-        
-        if (stopPressed || startPressed) {
-          mayanLCDDropCase();
-          digitalWrite(SOLENOID_PIN, HIGH);
-          mayanState = DROP_CASE_TIMER_MAYAN;
-          Timer.restart();
-          stopPressed = false;
-          startPressed = false;
-    
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-        }
-        
-        break;
-      }
-  
-      ////////////////////////////////
-      // DROP_CASE_TIMER_MAYAN
-      //
-      // Close the solenoid at the right time
-      // Update the display on normal cycle
-      ////////////////////////////////
-  
-      case DROP_CASE_TIMER_MAYAN: {
-        #ifdef DEBUG_STATE
-        if (stateChange) { Serial.println(F("DEBUG: STATE MACHINE: enter DROP_CASE_TIMER_MAYAN")); stateChange = false; }
-        #endif
-  
-      
-        if (Timer.hasPassed((int) caseDropSetPoint * 1000)) {
-          digitalWrite(SOLENOID_PIN, LOW);
-          mayanState = PAUSE_WAIT;
-          mayanScreenUpdate = true;
-  
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-        }
-  
-        break;
-      }
+    ////////////////////////////////////////////////////////
+    // Then the state machine for the Mayan cycle
+    ////////////////////////////////////////////////////////
   
-      ////////////////////////////////
-      // PAUSE_WAIT
-      //
-      // Wait for user to proceed while
-      // results are displayed for them
-      ////////////////////////////////
-
-
-      case PAUSE_WAIT: {
-        #ifdef DEBUG_STATE
-        Serial.println(F("DEBUG: STATE MACHINE: enter PAUSE_WAIT")); stateChange = false;
-        #endif
-        
-        if (mayanScreenUpdate) {
-          mayanScreenUpdate = false;
-          mayanLCDPauseWait();
-        }
-
-        if (stopPressed) { // we're ending this cycle 
-
-          if (mayanUseSD) {
-            annealLogCloseFile();
-          }
-          mayanStartMillis = 0;
-          mayanCurrentMillis = 0;
-          mayanLoopCount = 0;
-          mayanCycleCount = 0;
-          mayanAccRec = 0.0;
-          mayanRecommendation = 0.0;
-
-          mayanState = WAIT_BUTTON_MAYAN;
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-        }
-        else if (startPressed) { // going to another case in this cycle
-          
-          mayanState = WAIT_BUTTON_MAYAN;
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-        }     
-        break;
-      }
-
-    
-      ////////////////////////////////
-      // ABORTED
-      //
-      // Ask how to proceed
-      ////////////////////////////////
-      
-      case ABORTED: {
-        #ifdef DEBUG_STATE
-        Serial.println(F("DEBUG: STATE MACHINE: enter ABORTED")); stateChange = false; 
-        #endif
-
-        // show something appropriate on the LCD, based on which state we're in
-
-        if (mayanScreenUpdate) {
-          mayanScreenUpdate = false;
-          mayanLCDAbort();
-        }
-        
-        if (stopPressed) { // we're ending this cycle 
-
-          if (mayanUseSD) {
-            // do what's needed to close the file
-          }
-
-          mayanLCDLeaveAbort();
-          
-          mayanStartMillis = 0;
-          mayanCurrentMillis = 0;
-          mayanLoopCount = 0;
-          mayanCycleCount = 0;
-          mayanAccRec = 0.0;
-          mayanRecommendation = 0.0;
-
-          mayanState = WAIT_BUTTON_MAYAN;
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-        }
-        else if (startPressed) { // going to another case in this cycle
-
-          mayanLCDLeaveAbort();
-          
-          mayanState = WAIT_BUTTON_MAYAN;
-          #ifdef DEBUG_STATE
-          stateChange = true;
-          #endif
-          
-        }
-        break;
-      }
-      
-    } // switch(mayanState)
-
+    mayanFsm.run();
   
  }
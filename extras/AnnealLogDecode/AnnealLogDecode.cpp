@@ -0,0 +1,113 @@
+/**************************************************************************************************
+ *
+ * AnnealLogDecode.cpp
+ * Annealer Control Program
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Command line decoder for the binary Mayan logs (the .BIN files on the OpenLog's card). Writes
+ * the same "cycle,timestamp,amps,volts" CSV the sketch writes with LOG_FORMAT_CSV turned on,
+ * trailer lines and all, so anything built around the old files keeps working.
+ *
+ * This is a PC program, not part of the sketch - the Arduino IDE doesn't build anything under
+ * extras/. On Linux or macOS:
+ *
+ *   g++ -std=c++11 -O2 -o anneal-log-decode AnnealLogDecode.cpp
+ *   ./anneal-log-decode 12.BIN > 12.CSV
+ *
+ * With no file name, it reads standard input. Exits non-zero on a file it doesn't recognize, or
+ * one that's been cut off partway through a record - whatever decoded cleanly up to that point
+ * has already been written out.
+ *
+ **************************************************************************************************/
+
+#include <cstdio>
+#include <cstdint>
+#include "../../AnnealLogFormat.h"
+
+static bool readBytes(FILE *in, uint8_t *buf, size_t length) {
+  return fread(buf, 1, length, in) == length;
+}
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static int decode(FILE *in, const char *name) {
+  uint8_t record[LOG_ABSOLUTE_LENGTH];
+  unsigned int cycle = 0;
+  unsigned int timestamp = 0;
+  unsigned int amps = 0;
+  unsigned int volts = 0;
+  int tag;
+
+  if (!readBytes(in, record, LOG_HEADER_LENGTH) ||
+      (record[0] != LOG_MAGIC_0) || (record[1] != LOG_MAGIC_1) ||
+      (record[2] != LOG_MAGIC_2) || (record[3] != LOG_MAGIC_3)) {
+    fprintf(stderr, "%s: not an annealer log\n", name);
+    return 1;
+  }
+  if (record[4] != LOG_FORMAT_VERSION) {
+    fprintf(stderr, "%s: log format version %u, this decoder only knows %u\n", name, record[4], LOG_FORMAT_VERSION);
+    return 1;
+  }
+
+  while ((tag = fgetc(in)) != EOF) {
+    record[0] = tag;
+
+    switch (tag) {
+      case LOG_TAG_RUN_START:
+        if (!readBytes(in, &record[1], LOG_RUN_START_LENGTH - 1)) break;
+        cycle = get16(&record[1]);
+        timestamp = amps = volts = 0;
+        continue;
+
+      case LOG_TAG_TRAILER:
+        if (!readBytes(in, &record[1], LOG_TRAILER_LENGTH - 1)) break;
+        printf("#%u,%u,%5.2f\n", get16(&record[1]), get16(&record[3]), get16(&record[5]) / 100.0);
+        continue;
+
+      case LOG_TAG_ABSOLUTE:
+        if (!readBytes(in, &record[1], LOG_ABSOLUTE_LENGTH - 1)) break;
+        timestamp = get16(&record[1]);
+        amps = get16(&record[3]);
+        volts = get16(&record[5]);
+        printf("%u,%u,%5.2f,%5.2f\n", cycle, timestamp, amps / 100.0, volts / 100.0);
+        continue;
+
+      default: // delta sample
+        if (!readBytes(in, &record[1], LOG_DELTA_LENGTH - 1)) break;
+        timestamp += record[0];
+        amps = (amps + (int8_t) record[1]) & 0xFFFF;
+        volts = (volts + (int8_t) record[2]) & 0xFFFF;
+        printf("%u,%u,%5.2f,%5.2f\n", cycle, timestamp, amps / 100.0, volts / 100.0);
+        continue;
+    }
+
+    fprintf(stderr, "%s: truncated record (tag 0x%02X)\n", name, tag);
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int rc = 0;
+
+  if (argc < 2) {
+    return decode(stdin, "stdin");
+  }
+
+  for (int i = 1; i < argc; i++) {
+    FILE *in = fopen(argv[i], "rb");
+    if (!in) {
+      perror(argv[i]);
+      rc = 1;
+      continue;
+    }
+    rc |= decode(in, argv[i]);
+    fclose(in);
+  }
+
+  return rc;
+}
@@ -0,0 +1,129 @@
+/**************************************************************************************************
+ *
+ * AnnealerSim.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Smoke test for the whole sketch on the simulated board: power up, go to Anneal from the menu,
+ * press start, and run a few minutes of cycles with no opto. Every inductor pulse is timed off
+ * the pin itself, and has to match the set point, the sketch's own reading of it, and the count
+ * of cases done. Along the way, the loop has to sleep between jobs, the trap door has to open
+ * once per case, and the stop button has to end it all with everything switched off.
+ *
+ * Then the same with the opto: cases fed back to back, each one dropping in as the last one
+ * falls out - with no gap at all, and with a gap shorter than OPTO_GLITCH_MS. Neither gives the
+ * opto a new arrival to see, and every case still has to get annealed.
+ *
+ **************************************************************************************************/
+
+#include "../../Annealer-Control.h"
+#include "HostSim.h"
+#include <stdio.h>
+#include <vector>
+
+Menu::result enterAnneal(void);
+
+int main(void) {
+  std::vector<uint64_t> pulses;
+  uint64_t inductorOn = 0;
+  unsigned int drops = 0;
+  int queued = -1;            // cases lined up behind the one on the opto - -1, no opto feed
+  uint64_t gapMicros = 0;     // how long the opto sees nothing as one replaces the next
+
+  simPinWatch = [&](uint8_t pin, uint8_t level) {
+    if (pin == INDUCTOR_PIN) {
+      if (level) inductorOn = simNow;
+      else pulses.push_back(simNow - inductorOn);
+    }
+    else if ((pin == SOLENOID_PIN) && level) {
+      drops++;
+      if (queued > 0) {
+        queued--;
+        if (gapMicros) {
+          simAt(simNow, []() { simPin(OPTO1_PIN, HIGH); });
+          simAt(simNow + gapMicros, []() { simPin(OPTO1_PIN, LOW); });
+        }
+      }
+      else if (queued == 0) {
+        simAt(simNow, []() { simPin(OPTO1_PIN, HIGH); });   // the last one, and nothing behind it
+      }
+    }
+  };
+
+  simAnalog(THERM1_PIN, simAnalogMax() / 2);
+  simAnalog(CURRENT_PIN, simAnalogMax() / 4);
+  simAnalog(VOLTAGE_PIN, simAnalogMax() / 2);
+
+  simBegin();
+  SIM_CHECK(pulses.empty());
+  SIM_CHECK(simPinLevel(INDUCTOR_PIN) == LOW);
+  SIM_CHECK(simPinLevel(SOLENOID_PIN) == LOW);
+
+  startOnOpto = false;
+  annealSetPoint = 1.5;
+  caseDropSetPoint = 1.0;     // whole seconds - the drop timer truncates it
+  delaySetPoint = 2.0;
+  delayGovernor = false;
+
+  enterAnneal();
+  simLoopUntil(simNow + 1000000);
+  SIM_CHECK(annealState == WAIT_BUTTON);
+  SIM_CHECK(pulses.empty());
+
+  unsigned long sleepsBefore = simSleeps;
+  simPress(START_PIN);
+  simLoopUntil(simNow + 180000000UL);
+
+  simPress(STOP_PIN);
+  simLoopUntil(simNow + 1000000);
+  SIM_CHECK(annealState == WAIT_BUTTON);
+  SIM_CHECK(simPinLevel(INDUCTOR_PIN) == LOW);
+  SIM_CHECK(simPinLevel(SOLENOID_PIN) == LOW);
+
+  // 1.5 + 1.0 + 2.0 seconds a case, give or take the loop
+  SIM_CHECK(pulses.size() >= 36);
+  SIM_CHECK(pulses.size() <= 41);
+  SIM_CHECK((drops == pulses.size()) || (drops + 1 == pulses.size()));
+
+  uint64_t late = 0;
+  for (size_t i = 0; i + 1 < pulses.size(); i++) {    // the last one may have been stopped short
+    SIM_CHECK(pulses[i] >= 1500000);
+    if (pulses[i] - 1500000 > late) late = pulses[i] - 1500000;
+  }
+  // the cutoff can come due just as a sampler tick starts, and wait out every conversion in it
+  const uint64_t lateLimit = (SAMPLER_TICK_CONVERSIONS * SIM_ADC_US) + 50;
+  SIM_CHECK(late < lateLimit);
+  SIM_CHECK(annealLateMax * 1000.0 < lateLimit);
+  SIM_CHECK(simSleeps - sleepsBefore > 1000);
+
+  printf("%u cases, latest cutoff +%llu us, %lu loops, %lu sleeps (%.1f s asleep)\n",
+         (unsigned int) pulses.size(), (unsigned long long) late, simLoops, simSleeps,
+         simSleptMicros / 1e6);
+
+  // three cases back to back on the opto, then nothing - about 5 seconds a case
+  startOnOpto = true;
+  const uint64_t gaps[] = { 0, (OPTO_GLITCH_MS / 2) * 1000UL };
+  for (unsigned int g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+    pulses.clear();
+    drops = 0;
+    queued = 2;
+    gapMicros = gaps[g];
+    simPin(OPTO1_PIN, LOW);
+
+    simPress(START_PIN);
+    simLoopUntil(simNow + 30000000UL);
+    printf("back to back, %llu us gap: %u of 3 cases annealed\n", (unsigned long long) gapMicros,
+           (unsigned int) pulses.size());
+    SIM_CHECK(pulses.size() == 3);
+    SIM_CHECK(drops == 3);
+    SIM_CHECK(annealState == WAIT_CASE);
+    SIM_CHECK(simPinLevel(OPTO1_PIN) == HIGH);
+
+    simPress(STOP_PIN);
+    simLoopUntil(simNow + 1000000);
+    SIM_CHECK(annealState == WAIT_BUTTON);
+  }
+
+  return simReport("AnnealerSim");
+}
@@ -0,0 +1,265 @@
+/**************************************************************************************************
+ *
+ * FilterBench.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The integer filters in AnnealFilters.h - checked for gain, step response, and headroom on a
+ * full scale sampler sum, and against float versions of the same filters - then timed per sample
+ * against the float smoothing they replaced, the old
+ *
+ *   amps = ((1.0 - AMPS_SMOOTH_RATIO) * amps) + (AMPS_SMOOTH_RATIO * ampsNow);
+ *
+ * Doesn't need the simulated board, just a PC:
+ *
+ *   make check                  runs the checks, along with the other tests
+ *   obj-artemis/FilterBench     the checks and the timings
+ *
+ * The host has a floating point unit, so the timings here are the float code's best case. On an
+ * AVR, every one of those float multiplies and adds is a software routine.
+ *
+ **************************************************************************************************/
+
+#include "../../Annealer-Control.h"
+#include <stdio.h>
+#include <chrono>
+
+// the bigger of the two sums a filter sees - power, or the thermistor's
+#define FILTER_SUM_SCALE        ((POWER_SAMPLE_SCALE > SAMPLER_SAMPLE_READS) ? POWER_SAMPLE_SCALE : SAMPLER_SAMPLE_READS)
+#define FILTER_FULL_SCALE       ((uint32_t) (RESOLUTION_MAX - 1) * FILTER_SUM_SCALE)
+#define FILTER_BENCH_SAMPLES    20000000L
+
+static unsigned long failures = 0;
+
+static void check(bool ok, const char *what, double got, double want) {
+  if (!ok) {
+    if (failures++ < 20) fprintf(stderr, "%s: got %.4f, want %.4f\n", what, got, want);
+  }
+}
+
+static double counts(int32_t value) {
+  return value / (double) (1L << FILTER_FRAC_BITS);
+}
+
+
+// float versions of the same filters, to check the integer ones against
+struct FloatEma {
+  double ratio, state;
+  FloatEma(double r) : ratio(r), state(0) {}
+  void reset(double x) { state = x; }
+  void add(double x) { state = ((1.0 - ratio) * state) + (ratio * x); }
+};
+
+struct FloatBiquad {
+  double b0, b1, b2, a1, a2, x1, x2, y1, y2;
+  FloatBiquad(int nb0, int nb1, int nb2, int da1, int da2) :
+    b0(nb0 / 16384.0), b1(nb1 / 16384.0), b2(nb2 / 16384.0), a1(da1 / 16384.0), a2(da2 / 16384.0),
+    x1(0), x2(0), y1(0), y2(0) {}
+  void reset(double x) { x1 = x2 = y1 = y2 = x; }
+  void add(double x) {
+    double y = (b0 * x) + (b1 * x1) + (b2 * x2) - (a1 * y1) - (a2 * y2);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+  }
+};
+
+// the same noisy, wandering input for everybody
+static uint32_t input(long i) {
+  static uint32_t seed = 12345;
+  seed = (seed * 1103515245UL) + 12345UL;
+  long base = (FILTER_FULL_SCALE / 2) + (long) ((FILTER_FULL_SCALE / 3) * sin(i / 50.0));
+  long noise = FILTER_FULL_SCALE / 40;
+  return base + ((long) ((seed >> 16) % (2 * noise + 1))) - noise;
+}
+
+
+/*
+ * DC gain - start anywhere, hold an input, and it has to end up there: exactly, for the moving
+ * average, or within the rounding - the EMA's shift can leave it off by less than 2^SHIFT in
+ * the fraction bits, the biquad's by one
+ */
+template <typename F>
+static void checkSettle(const char *name, int32_t slack, long steps) {
+  const uint32_t levels[] = { 0, 1, 1000, FILTER_FULL_SCALE / 2, FILTER_FULL_SCALE };
+  const int n = sizeof(levels) / sizeof(levels[0]);
+
+  for (int from = 0; from < n; from++) {
+    for (int to = 0; to < n; to++) {
+      F f;
+      f.reset(levels[from]);
+      for (long i = 0; i < steps; i++) f.add(levels[to]);
+
+      int32_t want = (int32_t) levels[to] << FILTER_FRAC_BITS;
+      check(abs(f.value() - want) <= slack, name, counts(f.value()), counts(want));
+    }
+  }
+
+  F held;
+  held.reset(FILTER_FULL_SCALE);
+  for (long i = 0; i < steps; i++) held.add(FILTER_FULL_SCALE);
+  check(held.value() == ((int32_t) FILTER_FULL_SCALE << FILTER_FRAC_BITS), name, counts(held.value()), FILTER_FULL_SCALE);
+}
+
+// the integer EMA tracks a float EMA of the same weight to within a count
+template <uint8_t NUM, uint8_t SHIFT>
+static void checkEma(const char *name) {
+  EmaFilter<NUM, SHIFT> f;
+  FloatEma ref((double) NUM / (1 << SHIFT));
+  double worst = 0;
+
+  f.reset(FILTER_FULL_SCALE / 2);
+  ref.reset(FILTER_FULL_SCALE / 2);
+  for (long i = 0; i < 100000; i++) {
+    uint32_t x = input(i);
+    f.add(x);
+    ref.add(x);
+    worst = fmax(worst, fabs(counts(f.value()) - ref.state));
+  }
+  printf("  %-22s worst %.3f counts from float\n", name, worst);
+  check(worst <= 1.0, name, worst, 1.0);
+}
+
+static void checkMovingAverage(void) {
+  MovingAverage<8> f;
+  uint32_t last[8];
+  double worst = 0;
+
+  f.reset(500);
+  for (int i = 0; i < 8; i++) last[i] = 500;
+  for (long i = 0; i < 100000; i++) {
+    uint32_t x = input(i);
+    uint64_t sum = 0;
+
+    f.add(x);
+    last[i % 8] = x;
+    for (int j = 0; j < 8; j++) sum += last[j];
+    worst = fmax(worst, fabs(counts(f.value()) - (sum / 8.0)));
+  }
+  printf("  %-22s worst %.3f counts from the plain average\n", "MovingAverage<8>", worst);
+  check(worst < (1.0 / (1 << FILTER_FRAC_BITS)), "MovingAverage<8>", worst, 0);
+}
+
+// Butterworth step response - a second order one overshoots about 4.3% - and against float
+static void checkBiquad(void) {
+  ButterLowPassTenth f;
+  FloatBiquad ref(1105, 2210, 1105, -18727, 6763);
+  double peak = 0, worst = 0;
+  int settled = -1;
+
+  f.reset(0);
+  ref.reset(0);
+  for (int i = 0; i < 200; i++) {
+    f.add(FILTER_FULL_SCALE);
+    ref.add(FILTER_FULL_SCALE);
+    peak = fmax(peak, counts(f.value()));
+    worst = fmax(worst, fabs(counts(f.value()) - ref.y1));
+    if ((settled < 0) && (fabs(counts(f.value()) - FILTER_FULL_SCALE) < FILTER_FULL_SCALE * 0.02)) settled = i;
+    else if (fabs(counts(f.value()) - FILTER_FULL_SCALE) >= FILTER_FULL_SCALE * 0.02) settled = -1;
+  }
+
+  double overshoot = (peak / FILTER_FULL_SCALE) - 1.0;
+  printf("  %-22s overshoot %.2f%%, within 2%% after %d samples, worst %.3f counts from float\n",
+         "ButterLowPassTenth", overshoot * 100.0, settled + 1, worst);
+  check((overshoot > 0.03) && (overshoot < 0.06), "ButterLowPassTenth overshoot", overshoot, 0.043);
+  check((settled >= 0) && (settled < 20), "ButterLowPassTenth settling", settled, 20);
+  check(worst <= 1.0, "ButterLowPassTenth against float", worst, 1.0);
+
+  for (long i = 0; i < 100000; i++) {
+    uint32_t x = input(i);
+    f.add(x);
+    ref.add(x);
+    worst = fmax(worst, fabs(counts(f.value()) - ref.y1));
+  }
+  check(worst <= 1.0, "ButterLowPassTenth against float, noisy", worst, 1.0);
+}
+
+// a straight line has to come out with its own slope
+static void checkSlope(void) {
+  SlopeWindow<10> w;
+
+  for (int32_t rate = -50; rate <= 50; rate += 5) {
+    w.reset();
+    for (int i = 0; i < 25; i++) {
+      w.add(1000 + (rate * i));
+      if (i < 9) check(!w.full(), "SlopeWindow full", w.full(), 0);
+    }
+
+    // rate per sample, at 1000ms a sample, is rate per second
+    check(w.full(), "SlopeWindow full", w.full(), 1);
+    check(!w.slopeBelow(rate, 1000) && !w.slopeAbove(rate, 1000), "SlopeWindow exact", rate, rate);
+    check(w.slopeBelow(rate + 1, 1000), "SlopeWindow below", rate, rate + 1);
+    check(w.slopeAbove(rate - 1, 1000), "SlopeWindow above", rate, rate - 1);
+  }
+}
+
+
+/*
+ * timing
+ */
+static volatile double sink;
+
+template <typename F>
+static double benchInt(void) {
+  F f;
+  f.reset(FILTER_FULL_SCALE / 2);
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < FILTER_BENCH_SAMPLES; i++) f.add((uint32_t) (i & 0xFFFF));
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  sink = f.value();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / FILTER_BENCH_SAMPLES;
+}
+
+// the old way, in float, the same as the sketch had it - amps and Therm1Avg were floats
+static double benchFloatEma(float ratio) {
+  float state = FILTER_FULL_SCALE / 2;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < FILTER_BENCH_SAMPLES; i++) {
+    state = ((1.0 - ratio) * state) + (ratio * ((i & 0xFFFF) / (float) FILTER_SUM_SCALE));
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  sink = state;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / FILTER_BENCH_SAMPLES;
+}
+
+static double benchFloatBiquad(void) {
+  FloatBiquad f(1105, 2210, 1105, -18727, 6763);
+  f.reset(FILTER_FULL_SCALE / 2);
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (long i = 0; i < FILTER_BENCH_SAMPLES; i++) f.add(i & 0xFFFF);
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  sink = f.y1;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / FILTER_BENCH_SAMPLES;
+}
+
+int main(int argc, char **argv) {
+  printf("full scale sampler sum %lu (%d bit ADC, %d times a conversion)\n", (unsigned long) FILTER_FULL_SCALE,
+         (int) (log2(RESOLUTION_MAX) + 0.5), FILTER_SUM_SCALE);
+
+  checkSettle<EmaFilter<1, 0> >("EmaFilter<1,0>", 0, 1);
+  checkSettle<EmaFilter<1, 1> >("EmaFilter<1,1>", (1 << 1) - 1, 64);
+  checkSettle<EmaFilter<45, 7> >("EmaFilter<45,7>", (1 << 7) - 1, 200);
+  checkSettle<MovingAverage<8> >("MovingAverage<8>", 0, 8);
+  checkSettle<ButterLowPassTenth>("ButterLowPassTenth", 1, 400);
+
+  checkEma<1, 1>("EmaFilter<1,1>");
+  checkEma<45, 7>("EmaFilter<45,7>");
+  checkMovingAverage();
+  checkBiquad();
+  checkSlope();
+
+  // just the checks, for make check - the timings take a few seconds
+  if ((argc < 2) || strcmp(argv[1], "--check")) {
+    printf("per sample, float -> integer\n");
+    printf("  %-22s %5.2f -> %5.2f ns\n", "EMA 0.5 (anneal amps)", benchFloatEma(0.5), benchInt<AnnealAmpsFilter>());
+    printf("  %-22s %5.2f -> %5.2f ns\n", "EMA 0.35 (thermistor)", benchFloatEma(0.35), benchInt<Therm1Filter>());
+    printf("  %-22s %5.2f -> %5.2f ns\n", "Butterworth biquad", benchFloatBiquad(), benchInt<ButterLowPassTenth>());
+    printf("  %-22s         %5.2f ns\n", "MovingAverage<8>", benchInt<MovingAverage<8> >());
+  }
+
+  if (failures) printf("FilterBench: %lu check(s) failed\n", failures);
+  else printf("FilterBench: ok\n");
+  return failures ? 1 : 0;
+}
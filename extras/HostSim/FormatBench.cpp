@@ -0,0 +1,315 @@
+/**************************************************************************************************
+ *
+ * FormatBench.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The fixed point formatters in AnnealFormat.h - checked against printf, then timed field by
+ * field against the code they replaced: the global String output, built up with concat() and
+ * dtostrf() for each field, copied here from before the change. The String is a cut down copy of
+ * the Arduino core's WString - same exact-size realloc() growth, same itoa() into a stack buffer
+ * for numbers - and dtostrf() is the Apollo3 core's, sprintf() underneath.
+ *
+ * Doesn't need the simulated board, just a PC:
+ *
+ *   make bench                  runs this along with the other benchmarks
+ *   obj-artemis/FormatBench     on its own
+ *
+ * Host timings only say which way and roughly how far - the Artemis is a 48MHz Cortex-M4F, and
+ * the AVR boards are slower still. Cycles are the x86 timestamp counter, where there is one.
+ * Heap calls are counted exactly.
+ *
+ **************************************************************************************************/
+
+#include <Arduino.h>
+#include "../../AnnealFormat.h"
+#include <stdio.h>
+#include <chrono>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#define FORMAT_BENCH_ITERATIONS   2000000
+
+static unsigned long heapCalls = 0;
+static unsigned long failures = 0;
+
+
+/*
+ * The old way - a cut down WString, and dtostrf()
+ */
+class CoreString {
+  char *buffer = NULL;
+  unsigned int capacity = 0;
+  unsigned int len = 0;
+
+  bool reserve(unsigned int size) {
+    if (buffer && (capacity >= size)) return true;
+    char *grown = (char *) realloc(buffer, size + 1);   // exactly what's needed, like the core
+    heapCalls++;
+    if (!grown) return false;
+    buffer = grown;
+    capacity = size;
+    return true;
+  }
+
+public:
+  ~CoreString() { free(buffer); }
+
+  CoreString &operator=(const char *s) {
+    unsigned int n = strlen(s);
+    if (!reserve(n)) return *this;
+    len = n;
+    strcpy(buffer, s);
+    return *this;
+  }
+
+  void concat(const char *s) {
+    unsigned int n = strlen(s);
+    if (!reserve(len + n)) return;
+    strcpy(buffer + len, s);
+    len += n;
+  }
+
+  void concat(int n) {
+    char buf[2 + 3 * sizeof(int)];
+    snprintf(buf, sizeof(buf), "%d", n);    // itoa(), in the core
+    concat(buf);
+  }
+
+  const char *c_str(void) const { return buffer ? buffer : ""; }
+};
+
+static char *dtostrf(double val, signed char width, unsigned char prec, char *sout) {
+  char fmt[20];
+  sprintf(fmt, "%%%d.%df", width, prec);
+  sprintf(sout, fmt, val);
+  return sout;
+}
+
+static CoreString output;
+static int LCDquotient = 0;
+static int LCDremainder = 0;
+
+static const char *oldSetPoint(float v) {
+  char c[6];
+  output = "";
+  dtostrf(v, 5, 2, c);
+  output.concat(c);
+  return output.c_str();
+}
+
+static const char *oldTimer(unsigned long elapsed) {
+  output = "";
+  LCDquotient = elapsed / 1000;
+  LCDremainder = elapsed % 1000 / 10;
+  if (LCDquotient < 10) output.concat(" ");
+  output.concat(LCDquotient);
+  output.concat(".");
+  if (LCDremainder < 10) output.concat("0");
+  output.concat(LCDremainder);
+  return output.c_str();
+}
+
+static const char *oldCurrent(float v) {
+  output = "";
+  LCDremainder = (int) (v * 100);
+  LCDquotient = LCDremainder / 100;
+  LCDremainder = LCDremainder % 100;
+  if (LCDquotient < 10) output.concat(" ");
+  output.concat(LCDquotient);
+  output.concat(".");
+  if (LCDremainder < 10) output.concat("0");
+  output.concat(LCDremainder);
+  return output.c_str();
+}
+
+static const char *oldTherm1(float v) {
+  output = "";
+  LCDremainder = (int) (v * 10);
+  LCDquotient = LCDremainder / 10;
+  LCDremainder = LCDremainder % 10;
+  if (LCDquotient >= 100) {
+    output.concat(" ");
+    output.concat(LCDquotient);
+  }
+  else {
+    if (LCDquotient < 10) output.concat(" ");
+    output.concat(LCDquotient);
+    output.concat(".");
+    output.concat(LCDremainder);
+  }
+  return output.c_str();
+}
+
+static const char *oldARec(float v) {
+  char c[6];
+  output = "";
+  if (v < 10.0) output.concat(" ");
+  dtostrf(v, 5, 2, c);
+  output.concat(c);
+  return output.c_str();
+}
+
+static const char *oldRecommend(float v) {
+  char c[6];
+  output = "";
+  output.concat("  Recommend: ");
+  dtostrf(v, 5, 2, c);
+  output.concat(c);
+  output.concat("  ");
+  return output.c_str();
+}
+
+
+/*
+ * The new way - what AnnealLCD.cpp and MayanLCD.cpp do now
+ */
+static char newBuf[6];
+
+static const char *newSetPoint(float v) { return formatFixed<5,2>(newBuf, v); }
+static const char *newTimer(unsigned long elapsed) { return formatScaled<5,2>(newBuf, elapsed / 10); }
+static const char *newCurrent(float v) { return formatFixed<5,2>(newBuf, v); }
+static const char *newTherm1(float v) { return formatFixed<4,1>(newBuf, v); }
+static const char *newARec(float v) { return formatFixed<5,2>(newBuf, v); }
+static const char *newRecommend(float v) { return formatFixed<5,2>(newBuf, v); }
+
+
+/*
+ * correctness
+ */
+static void expect(const char *got, const char *want, const char *what, double value) {
+  if (strcmp(got, want)) {
+    if (failures++ < 20) fprintf(stderr, "%s(%g): got \"%s\", want \"%s\"\n", what, value, got, want);
+  }
+}
+
+// printf rounds the same way, as long as the value isn't sitting on a tie
+static void checkAgainstPrintf(void) {
+  char want[32];
+  char c[8];
+
+  for (long i = -999; i <= 9999; i++) {
+    float v = (i / 100.0) + 0.003;
+    snprintf(want, sizeof(want), "%5.2f", v);
+    expect(formatFixed<5,2>(c, v), want, "formatFixed<5,2>", v);
+
+    v = (i / 10.0) + 0.03;
+    if ((v > -9.9) && (v < 99.9)) {          // where it fits in 4 with the decimal
+      snprintf(want, sizeof(want), "%4.1f", v);
+      expect(formatFixed<4,1>(c, v), want, "formatFixed<4,1>", v);
+    }
+  }
+
+  for (long i = 0; i <= 9999; i++) {
+    snprintf(want, sizeof(want), "%2ld.%02ld", i / 100, i % 100);
+    expect(formatScaled<5,2>(c, i), want, "formatScaled<5,2>", i);
+  }
+}
+
+static void checkEdges(void) {
+  char c[8];
+  char u[12];
+
+  expect(formatFixed<5,2>(c, 0.0), " 0.00", "formatFixed<5,2>", 0.0);
+  expect(formatFixed<5,2>(c, 0.004), " 0.00", "formatFixed<5,2>", 0.004);
+  expect(formatFixed<5,2>(c, -0.004), " 0.00", "formatFixed<5,2>", -0.004);
+  expect(formatFixed<5,2>(c, 99.994), "99.99", "formatFixed<5,2>", 99.994);
+  expect(formatFixed<5,2>(c, 99.996), "  100", "formatFixed<5,2>", 99.996);    // decimals dropped
+  expect(formatFixed<5,2>(c, 12345.4), "12345", "formatFixed<5,2>", 12345.4);
+  expect(formatFixed<5,2>(c, 123456.0), "#####", "formatFixed<5,2>", 123456.0);
+  expect(formatFixed<5,2>(c, -1.5), "-1.50", "formatFixed<5,2>", -1.5);
+  expect(formatFixed<5,2>(c, -12.5), "  -13", "formatFixed<5,2>", -12.5);
+  expect(formatFixed<5,2>(c, -99999.0), "#####", "formatFixed<5,2>", -99999.0);
+  expect(formatFixed<4,1>(c, 123.4), " 123", "formatFixed<4,1>", 123.4);
+  expect(formatFixed<4,1>(c, 999.4), " 999", "formatFixed<4,1>", 999.4);
+  expect(formatFixed<4,1>(c, 9999.6), "####", "formatFixed<4,1>", 9999.6);
+  expect(formatScaled<2,0>(c, 0), " 0", "formatScaled<2,0>", 0);
+  expect(formatScaled<2,0>(c, 7), " 7", "formatScaled<2,0>", 7);
+  expect(formatScaled<2,0>(c, 42), "42", "formatScaled<2,0>", 42);
+  expect(formatScaled<2,0>(c, 100), "##", "formatScaled<2,0>", 100);
+  expect(formatScaled<3,0>(c, -5), " -5", "formatScaled<3,0>", -5);
+
+  if (formatUnsigned(u, 0) != u + 1) failures++;     // points at the null, for the next field
+  expect(u, "0", "formatUnsigned", 0);
+  formatUnsigned(u, 4294967295UL);
+  expect(u, "4294967295", "formatUnsigned", 4294967295.0);
+  formatUnsigned(formatUnsigned(u, 12), 345);
+  expect(u, "12345", "formatUnsigned", 12345);
+}
+
+// the set point always went through dtostrf(), so it should look exactly the same as before
+static void checkSameAsBefore(void) {
+  for (int i = 0; i <= 2000; i++) {
+    float v = i / 100.0;
+    char old[8];
+
+    strcpy(old, oldSetPoint(v));
+    expect(newSetPoint(v), old, "set point", v);
+  }
+}
+
+
+/*
+ * timing
+ */
+static volatile unsigned long sink;
+
+static uint64_t ticks(void) {
+  #ifdef __x86_64__
+  return __rdtsc();
+  #else
+  return 0;
+  #endif
+}
+
+template <typename T>
+static void bench(const char *name, const char *(*before)(T), const char *(*after)(T), T start, T step) {
+  const char *(*fns[2])(T) = { before, after };
+  double ns[2], cycles[2];
+  unsigned long calls[2];
+
+  for (int f = 0; f < 2; f++) {
+    T v = start;
+    unsigned long sum = 0;
+
+    (void) fns[f](v);   // so the first grow doesn't count
+    calls[f] = heapCalls;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = ticks();
+
+    for (long i = 0; i < FORMAT_BENCH_ITERATIONS; i++) {
+      sum += fns[f](v)[1];
+      v = ((i & 1023) == 1023) ? start : (T) (v + step);
+    }
+
+    uint64_t c1 = ticks();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    calls[f] = heapCalls - calls[f];
+    ns[f] = std::chrono::duration<double, std::nano>(t1 - t0).count() / FORMAT_BENCH_ITERATIONS;
+    cycles[f] = (double) (c1 - c0) / FORMAT_BENCH_ITERATIONS;
+    sink += sum;
+  }
+
+  printf("  %-10s %7.1f -> %6.1f ns  %7.1f -> %6.1f cycles  %5.1fx  heap calls %lu -> %lu\n",
+         name, ns[0], ns[1], cycles[0], cycles[1], ns[0] / ns[1], calls[0], calls[1]);
+}
+
+int main(void) {
+  checkAgainstPrintf();
+  checkEdges();
+  checkSameAsBefore();
+
+  printf("per field, before -> after, %d calls each\n", FORMAT_BENCH_ITERATIONS);
+  bench<float>("SETPOINT", oldSetPoint, newSetPoint, 0.37f, 0.37f);
+  bench<unsigned long>("TIMER", oldTimer, newTimer, 0UL, 37UL);
+  bench<float>("CURRENT", oldCurrent, newCurrent, 0.13f, 0.07f);
+  bench<float>("THERM1", oldTherm1, newTherm1, 60.0f, 0.13f);
+  bench<float>("ARec", oldARec, newARec, 0.37f, 0.01f);
+  bench<float>("Recommend", oldRecommend, newRecommend, 0.37f, 0.01f);
+
+  if (failures) printf("FormatBench: %lu check(s) failed\n", failures);
+  else printf("FormatBench: ok\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+/**************************************************************************************************
+ *
+ * HostHALTarget.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The board's timers for the host build - takes the place of AnnealHALApollo3.cpp,
+ * AnnealHALAVR.cpp, and AnnealHALOther.cpp (see AnnealHALTarget.h), under the real
+ * AnnealHAL.cpp, on the simulated board in HostSim.cpp. Timer interrupts are events that land on
+ * the timer's own tick boundaries, and wait like any other while interrupts are off.
+ *
+ * The artemis build has the Apollo3's: a 32-bit cutoff and the ticker, both at 3MHz. The
+ * generic build has an AVR's at HOST_F_CPU: the cutoff on Timer1 at F_CPU/64, 16 bits, chained
+ * in chunks by AnnealHAL.cpp, with the compare flag set the tick after the match; and the ticker
+ * on Timer2 at F_CPU/1024, rounded to the nearest tick. Both prescalers run free, so a timer
+ * started between ticks counts its first one early.
+ *
+ **************************************************************************************************/
+
+#include "../../AnnealHALTarget.h"
+#include "HostSim.h"
+
+#ifdef _AP3_VARIANT_H_
+  #define HOST_CUTOFF_HZ        3000000UL
+  #define HOST_CUTOFF_CHUNK     0xFFFFFFFFUL
+  #define HOST_CUTOFF_LAG       0
+  #define HOST_TICKER_HZ        3000000UL
+  #define HOST_TICKER_MAX       0x10000UL
+#else
+  #ifndef HOST_F_CPU
+  #define HOST_F_CPU            16000000UL
+  #endif
+  #define HOST_CUTOFF_HZ        (HOST_F_CPU / 64UL)
+  #define HOST_CUTOFF_CHUNK     0x8000UL
+  #define HOST_CUTOFF_LAG       1
+  #define HOST_TICKER_HZ        (HOST_F_CPU / 1024UL)
+  #define HOST_TICKER_MAX       256UL
+#endif
+
+const unsigned long halCutoffTicksPerSec = HOST_CUTOFF_HZ;
+const unsigned long halCutoffChunkMax = HOST_CUTOFF_CHUNK;
+
+static SimEvent hostCutoffEvent = 0;
+static uint64_t hostCutoffTick = 0;     // prescaler tick the counter's compare is set for
+static SimEvent hostTickerEvent = 0;
+
+
+// the start of prescaler tick n, in simNow microseconds
+static uint64_t hostTickMicros(uint64_t n, uint64_t hz) {
+  return ((n * 1000000ULL) + hz - 1) / hz;
+}
+
+static void hostCutoffSchedule(void) {
+  if (hostCutoffEvent) simCancel(hostCutoffEvent);
+  hostCutoffEvent = simAt(hostTickMicros(hostCutoffTick + HOST_CUTOFF_LAG, HOST_CUTOFF_HZ), []() {
+    hostCutoffEvent = 0;
+    halCutoffCompare();
+  });
+}
+
+void halTargetCutoffStart(unsigned long ticks) {
+  hostCutoffTick = ((simNow * HOST_CUTOFF_HZ) / 1000000ULL) + ticks;
+  hostCutoffSchedule();
+}
+
+void halTargetCutoffNext(unsigned long ticks) {
+  hostCutoffTick += ticks;
+  hostCutoffSchedule();
+}
+
+void halTargetCutoffStop(void) {
+  if (hostCutoffEvent) simCancel(hostCutoffEvent);
+}
+
+
+boolean halTargetTickerStart(unsigned long ms, void (*handler)(void)) {
+  uint64_t ticks = ((HOST_TICKER_HZ * (uint64_t) ms) + 500) / 1000;
+  uint64_t first = ((simNow * HOST_TICKER_HZ) / 1000000ULL) + ticks;
+
+  if ((ticks == 0) || (ticks > HOST_TICKER_MAX)) return false;
+
+  if (hostTickerEvent) simCancel(hostTickerEvent);
+  hostTickerEvent = simEvery(hostTickMicros(first, HOST_TICKER_HZ),
+                             hostTickMicros(ticks, HOST_TICKER_HZ), handler);
+  return true;
+}
+
+
+void halTargetSleep(void) {
+  simSleep();
+}
+
+
+boolean halTargetPinChange(uint8_t pin, void (*handler)(void)) {
+  (void) pin;
+  (void) handler;
+  return false;
+}
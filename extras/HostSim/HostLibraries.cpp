@@ -0,0 +1,133 @@
+/**************************************************************************************************
+ *
+ * HostLibraries.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The library objects and the out-of-line parts of the fakes under fakes/ - Wire, EEPROM, the
+ * SerLCD screen, the OpenLog's card, and the bits of ArduinoMenu that need a definition.
+ *
+ **************************************************************************************************/
+
+#include "HostSim.h"
+#include <EEPROM.h>
+#include <SerLCD.h>
+#include <SparkFun_Qwiic_OpenLog_Arduino_Library.h>
+#include <Wire.h>
+#include <menu.h>
+
+TwoWire Wire;
+EEPROMClass EEPROM;
+
+
+/*
+ * SerLCD
+ */
+SerLCD::SerLCD() {
+  for (uint8_t r = 0; r < SERLCD_ROWS; r++) {
+    memset(screen[r], ' ', SERLCD_COLS);
+    screen[r][SERLCD_COLS] = '\0';
+  }
+}
+
+// one I2C transaction of n bytes, and the library's wait after it
+void SerLCD::transfer(size_t n, unsigned long settleMs) {
+  transfers++;
+  bytes += n;
+  simSpend((bus ? bus->transferMicros(n) : 0) + (settleMs * 1000UL));
+}
+
+void SerLCD::clear(void) {
+  for (uint8_t r = 0; r < SERLCD_ROWS; r++) memset(screen[r], ' ', SERLCD_COLS);
+  col = row = 0;
+  transfer(2, SERLCD_COMMAND_MS);
+}
+
+void SerLCD::setCursor(uint8_t c, uint8_t r) {
+  col = (c < SERLCD_COLS) ? c : SERLCD_COLS - 1;
+  row = (r < SERLCD_ROWS) ? r : SERLCD_ROWS - 1;
+  transfer(2, SERLCD_SPECIAL_MS);
+}
+
+void SerLCD::setFastBacklight(uint8_t r, uint8_t g, uint8_t b) {
+  red = r;
+  green = g;
+  blue = b;
+  transfer(5, SERLCD_COMMAND_MS);
+}
+
+// the display wraps at the end of a line onto the next one, the way the HD44780 lays out rows
+size_t SerLCD::write(const uint8_t *buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    screen[row][col] = buffer[i];
+    if (++col >= SERLCD_COLS) {
+      col = 0;
+      row = (row + 1) % SERLCD_ROWS;
+    }
+  }
+  transfer(size, SERLCD_COMMAND_MS);
+  return size;
+}
+
+
+/*
+ * OpenLog
+ */
+bool OpenLog::searchDirectory(const String &pattern) {
+  const char *p = pattern.c_str();
+  const char *suffix = (p[0] == '*') ? p + 1 : p;
+
+  listing.clear();
+  listed = 0;
+  for (std::map<std::string, std::string>::iterator it = files.begin(); it != files.end(); ++it) {
+    if (String(it->first).endsWith(suffix)) listing.push_back(it->first);
+  }
+  simSpend(Wire.transferMicros(pattern.length()) + OPENLOG_WRITE_US);
+  return present;
+}
+
+String OpenLog::getNextDirectoryItem(void) {
+  simSpend(Wire.transferMicros(13));
+  return (listed < listing.size()) ? String(listing[listed++]) : String("");
+}
+
+bool OpenLog::append(const String &fileName) {
+  if (!present) return false;
+  current = fileName.c_str();
+  files[current];     // creates it, if it's new
+  simSpend(Wire.transferMicros(fileName.length() + 1) + OPENLOG_WRITE_US);
+  return true;
+}
+
+int32_t OpenLog::size(const String &fileName) {
+  std::map<std::string, std::string>::iterator it = files.find(fileName.c_str());
+
+  simSpend(Wire.transferMicros(fileName.length() + 5));
+  return (it == files.end()) ? -1 : (int32_t) it->second.size();
+}
+
+size_t OpenLog::write(const uint8_t *buffer, size_t size) {
+  if (!present || current.empty()) return 0;
+  files[current].append((const char *) buffer, size);
+  simSpend(Wire.transferMicros(size) + OPENLOG_WRITE_US);
+  return size;
+}
+
+
+/*
+ * ArduinoMenu
+ */
+namespace Menu {
+  static config hostOptions = {
+    { { noCmd, 0 }, { escCmd, '/' }, { enterCmd, '*' }, { upCmd, '+' }, { downCmd, '-' },
+      { leftCmd, '-' }, { rightCmd, '+' }, { idxCmd, '?' }, { selCmd, '*' } }
+  };
+  config *options = &hostOptions;
+
+  result inaction(menuOut &o, idleEvent e) {
+    (void) o;
+    (void) e;
+    return proceed;
+  }
+}
@@ -0,0 +1,347 @@
+/**************************************************************************************************
+ *
+ * HostSim.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The simulated board - virtual clock, interrupt events, pins, and ADC - and the Arduino core
+ * functions on top of it. See HostSim.h.
+ *
+ **************************************************************************************************/
+
+#include "HostSim.h"
+#include <Rencoder.h>
+#include <stdio.h>
+#include <map>
+
+extern Encoder encoder;
+void setup(void);
+void loop(void);
+
+uint64_t simNow = 0;
+unsigned long simLoopMicros = 20;
+unsigned long simLoops = 0;
+unsigned long simSleeps = 0;
+uint64_t simSleptMicros = 0;
+bool simSerialEcho = false;
+float simInternalTemp = 30.0;
+
+std::function<void(uint8_t pin, uint8_t level)> simPinWatch;
+std::function<int(uint8_t pin)> simAnalogSource;
+
+struct SimEntry {
+  SimEvent id;
+  uint64_t period;                // 0 for a one-shot
+  std::function<void(void)> fn;
+};
+
+static std::multimap<uint64_t, SimEntry> simEvents;   // equal times stay in the order added
+static SimEvent simNextId = 1;
+static bool simIrqOn = true;
+
+static uint8_t simLevel[SIM_PINS];
+static bool simDriven[SIM_PINS];      // a test has set this input - pull-ups don't matter
+static int simAnalogValue[SIM_PINS];
+static int simAdcBits = 10;
+
+struct SimIsr {
+  void (*handler)(void);
+  int mode;
+};
+static SimIsr simIsr[SIM_PINS];
+
+
+/*
+ * simDispatch
+ *
+ * Run everything due by until, oldest first - as long as interrupts are on. Periodic events are
+ * put back before they run, so one can cancel itself.
+ */
+static void simDispatch(uint64_t until) {
+  while (simIrqOn && !simEvents.empty() && (simEvents.begin()->first <= until)) {
+    std::multimap<uint64_t, SimEntry>::iterator it = simEvents.begin();
+    uint64_t at = it->first;
+    SimEntry entry = it->second;
+
+    simEvents.erase(it);
+    if (at > simNow) simNow = at;
+    if (entry.period) simEvents.insert(std::make_pair(at + entry.period, entry));
+
+    simIrqOn = false;
+    entry.fn();
+    simIrqOn = true;
+  }
+}
+
+void simSpend(uint64_t us) {
+  uint64_t until = simNow + us;
+
+  simDispatch(until);
+  if (until > simNow) simNow = until;
+}
+
+void simRunUntil(uint64_t when) {
+  if (when > simNow) simSpend(when - simNow);
+}
+
+// stop until the next interrupt
+void simSleep(void) {
+  if (simEvents.empty()) return;
+
+  uint64_t wake = simEvents.begin()->first;
+  if (wake > simNow) {
+    simSleeps++;
+    simSleptMicros += wake - simNow;
+    simNow = wake;
+  }
+  simDispatch(simNow);
+}
+
+SimEvent simAt(uint64_t when, std::function<void(void)> fn) {
+  return simEvery(when, 0, fn);
+}
+
+SimEvent simEvery(uint64_t first, uint64_t period, std::function<void(void)> fn) {
+  SimEntry entry = { simNextId++, period, fn };
+
+  simEvents.insert(std::make_pair((first > simNow) ? first : simNow, entry));
+  return entry.id;
+}
+
+void simCancel(SimEvent &event) {
+  for (std::multimap<uint64_t, SimEntry>::iterator it = simEvents.begin(); it != simEvents.end(); ++it) {
+    if (it->second.id == event) {
+      simEvents.erase(it);
+      break;
+    }
+  }
+  event = 0;
+}
+
+bool simInterruptsOn(void) {
+  return simIrqOn;
+}
+
+
+/*
+ * simPin
+ *
+ * Drive an input from outside the board - fires the pin's interrupt if this is an edge it's
+ * waiting for
+ */
+void simPin(uint8_t pin, uint8_t level) {
+  uint8_t was = simLevel[pin];
+
+  simDriven[pin] = true;
+  if (level == was) return;
+  simLevel[pin] = level;
+
+  if (simPinWatch) simPinWatch(pin, level);
+
+  SimIsr &isr = simIsr[pin];
+  if (isr.handler && ((isr.mode == CHANGE) || ((isr.mode == FALLING) && !level) || ((isr.mode == RISING) && level))) {
+    simAt(simNow, isr.handler);
+    simSpend(0);
+  }
+}
+
+uint8_t simPinLevel(uint8_t pin) {
+  return simLevel[pin];
+}
+
+void simAnalog(uint8_t pin, int counts) {
+  simAnalogValue[pin] = counts;
+}
+
+int simAnalogMax(void) {
+  return (1 << simAdcBits) - 1;
+}
+
+void simEncoderTurn(int steps) {
+  encoder.count += steps;
+}
+
+void simEncoderClick(void) {
+  encoder.clicked = true;
+}
+
+// press a button (pulled up, so active LOW) and let go holdMicros later
+void simPress(uint8_t pin, uint64_t holdMicros) {
+  simPin(pin, LOW);
+  simAt(simNow + holdMicros, [pin]() { simPin(pin, HIGH); });
+}
+
+
+void simBegin(void) {
+  setup();
+}
+
+void simLoop(void) {
+  loop();
+  simLoops++;
+  simSpend(simLoopMicros);
+}
+
+void simLoopUntil(uint64_t when) {
+  while (simNow < when) simLoop();
+}
+
+
+int simFailures = 0;
+
+bool simCheck(bool ok, const char *what, const char *file, int line) {
+  if (!ok) {
+    simFailures++;
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+  }
+  return ok;
+}
+
+// exit status for main()
+int simReport(const char *name) {
+  if (simFailures) printf("%s: %d check(s) failed\n", name, simFailures);
+  else printf("%s: ok\n", name);
+  return simFailures ? 1 : 0;
+}
+
+
+/*
+ * The Arduino core, on the simulated board
+ */
+void pinMode(uint8_t pin, uint8_t mode) {
+  if ((mode == INPUT_PULLUP) && !simDriven[pin]) simLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  level = level ? HIGH : LOW;
+  if (simLevel[pin] == level) return;
+
+  simLevel[pin] = level;
+  if (simPinWatch) simPinWatch(pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+  return simLevel[pin];
+}
+
+// The first conversion after switching pins still carries half the last one's charge - what
+// the HAL's settle read is there to throw away
+int analogRead(uint8_t pin) {
+  static uint8_t lastPin = SIM_PINS;
+  static int lastValue = 0;
+  int value = simAnalogSource ? simAnalogSource(pin) : simAnalogValue[pin];
+
+  if (pin != lastPin) {
+    int held = lastValue;
+    lastPin = pin;
+    lastValue = value;
+    value = (value + held) / 2;
+  }
+  else {
+    lastValue = value;
+  }
+
+  simSpend(SIM_ADC_US);
+  if (value < 0) return 0;
+  return (value > simAnalogMax()) ? simAnalogMax() : value;
+}
+
+void analogReadResolution(int bits) {
+  simAdcBits = bits;
+}
+
+#ifdef _AP3_VARIANT_H_
+float getInternalTemp(void) {
+  simSpend(SIM_ADC_US);
+  return simInternalTemp;
+}
+#endif
+
+unsigned long millis(void) {
+  simSpend(SIM_CLOCK_READ_US);
+  return simNow / 1000;
+}
+
+unsigned long micros(void) {
+  simSpend(SIM_CLOCK_READ_US);
+  return simNow;
+}
+
+void delay(unsigned long ms) {
+  simSpend((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  simSpend(us);
+}
+
+void attachInterrupt(int interrupt, void (*handler)(void), int mode) {
+  if ((interrupt < 0) || (interrupt >= SIM_PINS)) return;
+  simIsr[interrupt].handler = handler;
+  simIsr[interrupt].mode = mode;
+}
+
+void detachInterrupt(int interrupt) {
+  if ((interrupt < 0) || (interrupt >= SIM_PINS)) return;
+  simIsr[interrupt].handler = NULL;
+}
+
+void noInterrupts(void) {
+  simIrqOn = false;
+}
+
+void interrupts(void) {
+  simIrqOn = true;
+  simDispatch(simNow);
+}
+
+
+/*
+ * Print and Serial
+ */
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+
+  if (base < 2) base = 10;
+  *str = '\0';
+  do {
+    unsigned long digit = n % base;
+    n /= base;
+    *--str = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+  } while (n);
+
+  return write(str);
+}
+
+size_t Print::print(long n, int base) {
+  if ((n < 0) && (base == DEC)) {
+    return print('-') + printNumber(-(unsigned long) n, DEC);
+  }
+  return printNumber((unsigned long) n, base);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[48];
+
+  if (isnan(n)) return print("nan");
+  if (isinf(n)) return print("inf");
+  if ((n > 4294967040.0) || (n < -4294967040.0)) return print("ovf");   // same limits as the core
+
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (simSerialEcho) putchar(c);
+  return 1;
+}
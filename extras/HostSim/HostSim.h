@@ -0,0 +1,89 @@
+/**************************************************************************************************
+ *
+ * HostSim.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The simulated board the host build runs on. Time is virtual, in microseconds, and only moves
+ * when something spends it:
+ *
+ * - every clock read (millis(), micros()) costs SIM_CLOCK_READ_US, so a busy wait still ends
+ * - every ADC conversion costs SIM_ADC_US, and the first one after switching pins reads halfway
+ *   to the last pin, like a sample and hold that hasn't settled
+ * - delay(), the LCD, and the OpenLog cost what they'd cost on the board - see the fake
+ *   libraries under fakes/
+ * - simLoop() charges simLoopMicros for the rest of each pass of loop()
+ * - halSleep() skips ahead to the next interrupt
+ *
+ * Interrupts are events on the same clock - the sampler's ticker, the inductor cutoff, and
+ * whatever a test schedules with simAt(). They fire as time passes over them, unless interrupts
+ * are off, in which case they wait for interrupts() - same as the real thing. An event runs with
+ * interrupts off, like an ISR.
+ *
+ * Inputs are driven from outside: simPin() for the buttons and opto sensors (firing their
+ * interrupts on the right edge), simAnalog() or simAnalogSource for the ADC, simEncoderTurn()
+ * and simEncoderClick() for the knob. Outputs can be watched with simPinWatch, which sees every
+ * level change with the time it happened.
+ *
+ * A simulation compiles the whole sketch, unchanged, with HostHALTarget.cpp in place of the
+ * board's timer files (AnnealHALTarget.h) and the fakes/ directory ahead of the real libraries -
+ * see the Makefile.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_SIM_H
+#define _HOST_SIM_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define SIM_PINS              NUM_DIGITAL_PINS
+#define SIM_CLOCK_READ_US     1
+#define SIM_ADC_US            10      // Apollo3, at the core's default clocking
+
+extern uint64_t simNow;                 // microseconds since power on
+extern unsigned long simLoopMicros;     // cost of one pass of loop(), outside of what's charged
+extern unsigned long simLoops;          // passes of loop() so far
+extern unsigned long simSleeps;         // halSleep() calls that actually slept
+extern uint64_t simSleptMicros;
+extern bool simSerialEcho;              // copy Serial to stdout
+extern float simInternalTemp;           // degrees C - the Apollo3's own sensor
+
+extern std::function<void(uint8_t pin, uint8_t level)> simPinWatch;
+extern std::function<int(uint8_t pin)> simAnalogSource;   // overrides simAnalog() when set
+
+typedef unsigned long SimEvent;
+
+// time
+void simSpend(uint64_t us);
+void simRunUntil(uint64_t when);
+void simSleep(void);
+SimEvent simAt(uint64_t when, std::function<void(void)> fn);
+SimEvent simEvery(uint64_t first, uint64_t period, std::function<void(void)> fn);
+void simCancel(SimEvent &event);
+bool simInterruptsOn(void);
+
+// pins
+void simPin(uint8_t pin, uint8_t level);
+uint8_t simPinLevel(uint8_t pin);
+void simAnalog(uint8_t pin, int counts);
+int simAnalogMax(void);
+
+// knob and buttons
+void simEncoderTurn(int steps);
+void simEncoderClick(void);
+void simPress(uint8_t pin, uint64_t holdMicros = 100000);
+
+// run the sketch
+void simBegin(void);
+void simLoop(void);
+void simLoopUntil(uint64_t when);
+
+// the tests - a failed check is counted and reported, and the run carries on
+extern int simFailures;
+#define SIM_CHECK(cond) simCheck((cond), #cond, __FILE__, __LINE__)
+bool simCheck(bool ok, const char *what, const char *file, int line);
+int simReport(const char *name);
+
+#endif // _HOST_SIM_H
@@ -0,0 +1,144 @@
+/**************************************************************************************************
+ *
+ * ThermistorTest.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The thermistor lookup table (AnnealThermistor.h) against the beta formula it stands in for,
+ * and how long a reading takes each way. Run for both ADCs:
+ *
+ *   make check                  the Artemis build - 14 bits
+ *   make check BOARD=generic    the AVR-style build - 10 bits
+ *
+ * Every 1/16th of a count across the ADC range goes through the sketch's own thermistorTemp(),
+ * and is held to what AnnealThermistor.h promises: within THERM_TEST_LIMIT_F from 0-250F, and
+ * THERM_TEST_LIMIT_HOT_F on up to 300F, of the formula worked out in long double.
+ *
+ * On an AVR, double is the same 32 bit float as float, so avr-gcc works the table out at that
+ * precision. The same table gets built here in float, and held to the same limits, so what the
+ * AVR boards get is covered too.
+ *
+ * The old calcSteinhart(), copied from before the table, is in here for the timing - and for
+ * how far off its own float math was.
+ *
+ **************************************************************************************************/
+
+#include "../../Annealer-Control.h"
+#include "../../AnnealThermistor.h"
+#include "HostSim.h"
+#include <stdio.h>
+#include <chrono>
+
+#define THERM_TEST_LIMIT_F        0.2
+#define THERM_TEST_LIMIT_HOT_F    0.5
+#define THERM_BENCH_PASSES        50
+
+typedef ThermTable<float, ThermMakeIndices<THERM_LUT_SIZE>::type> ThermLUTFloat;
+
+static long double exactTemp(long double counts) {
+  long double ohms = THERM_RESISTOR / ((RESOLUTION_MAX / counts) - 1.0L);
+  long double kelvin = 1.0L / ((logl(ohms / THERM_NOMINAL) / THERM_BETA) + (1.0L / (THERM_NOM_TEMP + 273.15L)));
+  return ((kelvin - 273.15L) * 1.8L) + 32.0L;
+}
+
+// the old way, as it was
+static float calcSteinhart(float input) {
+  float output = 0.0;
+  output = (THERM_RESISTOR / ((RESOLUTION_MAX / input) - 1)); // this gives us measured resistance in ohms!
+  output = output / THERM_NOMINAL;
+  output = log(output);
+  output /= THERM_BETA;
+  output += 1.0 / (THERM_NOM_TEMP + 273.15);
+  output = 1.0 / output;
+  output -= 273.15;
+  output = output * 1.8 + 32.0;
+
+  return output;
+}
+
+// thermistorTemp(), on the float-built table
+static float thermistorTempFloat(long x) {
+  const long segment = THERM_LUT_STEP * 16L;
+  long below = ThermLUTFloat::tenths[x / segment];
+  long above = ThermLUTFloat::tenths[(x / segment) + 1];
+  long step = (above - below) * (x % segment);
+
+  step = (step + ((step < 0) ? -(segment / 2) : (segment / 2))) / segment;
+  return (below + step) * 0.1;
+}
+
+struct ThermError {
+  double worst = 0.0;
+  double worstHot = 0.0;
+  long at = 0;
+  long atHot = 0;
+
+  void add(double err, long double ref, long x) {
+    err = fabs(err);
+    if ((ref >= 0.0) && (ref <= 250.0) && (err > worst)) {
+      worst = err;
+      at = x;
+    }
+    if ((ref > 250.0) && (ref <= 300.0) && (err > worstHot)) {
+      worstHot = err;
+      atHot = x;
+    }
+  }
+
+  void print(const char *name) {
+    printf("  %-14s 0-250F %.3fF (at %.2f counts)  250-300F %.3fF (at %.2f counts)\n", name,
+           worst, at / 16.0, worstHot, atHot / 16.0);
+  }
+};
+
+static volatile float sink;
+
+int main(void) {
+  ThermError table, tableFloat, old;
+
+  printf("%d bit ADC, %d entry table\n", (int) (log2(RESOLUTION_MAX) + 0.5), THERM_LUT_SIZE);
+
+  for (int i = 1; i < THERM_LUT_SIZE; i++) {
+    SIM_CHECK(ThermLUT::tenths[i] <= ThermLUT::tenths[i - 1]);      // hotter as the counts go up
+    SIM_CHECK(ThermLUTFloat::tenths[i] <= ThermLUTFloat::tenths[i - 1]);
+  }
+
+  for (long x = 16; x < (RESOLUTION_MAX - 1) * 16L; x++) {
+    long double ref = exactTemp(x / 16.0L);
+
+    table.add(thermistorTemp(x) - ref, ref, x);
+    tableFloat.add(thermistorTempFloat(x) - ref, ref, x);
+    old.add(calcSteinhart(x / 16.0f) - ref, ref, x);
+  }
+
+  printf("worst error against the formula\n");
+  table.print("table");
+  tableFloat.print("table (float)");
+  old.print("calcSteinhart");
+
+  SIM_CHECK(table.worst <= THERM_TEST_LIMIT_F);
+  SIM_CHECK(table.worstHot <= THERM_TEST_LIMIT_HOT_F);
+  SIM_CHECK(tableFloat.worst <= THERM_TEST_LIMIT_F);
+  SIM_CHECK(tableFloat.worstHot <= THERM_TEST_LIMIT_HOT_F);
+
+  // timing - host FPU, so this understates it; on an AVR, log() alone is thousands of cycles
+  double ns[2];
+  for (int f = 0; f < 2; f++) {
+    float sum = 0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    for (int pass = 0; pass < THERM_BENCH_PASSES; pass++) {
+      for (long c = 1; c < RESOLUTION_MAX; c++) {
+        sum += f ? thermistorTemp(c * 16L) : calcSteinhart((float) c);
+      }
+    }
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    ns[f] = std::chrono::duration<double, std::nano>(t1 - t0).count() / (THERM_BENCH_PASSES * (RESOLUTION_MAX - 1.0));
+    sink = sum;
+  }
+  printf("per reading: calcSteinhart %.1f ns, table %.1f ns (%.1fx)\n", ns[0], ns[1], ns[0] / ns[1]);
+
+  return simReport("ThermistorTest");
+}
@@ -0,0 +1,161 @@
+/**************************************************************************************************
+ *
+ * TimingBench.cpp
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Anneal timing accuracy, on the simulated board. Built with DEBUG_TIMING_SWEEP and
+ * DEBUG_COSTMODEL (see Annealer-Control.h), so annealSetPoint walks the whole 0-20 second range
+ * and every LCD field print and power sensor read costs what the Makefile says it does:
+ *
+ *   make bench                           COSTMODEL_LCD_MICROS 2000, COSTMODEL_POWER_MICROS 300
+ *   make bench LCD_US=10000 POWER_US=0   or whatever you like
+ *   make bench BOARD=generic             AVR timers - see below
+ *   obj-artemis/sweep-2000-300/TimingBench 5000     more cycles than the default 2000
+ *
+ * Everything is timed off the pins, not the sketch's own numbers:
+ *
+ * - late - how much longer INDUCTOR_PIN stayed HIGH than the set point asked for. The cutoff
+ *   runs on the host's copy of the board's timer (HostHALTarget.cpp) - its tick, its chunks, and
+ *   an interrupt that waits while interrupts are off - so this is rounding plus however long
+ *   the cutoff sat behind a sampler tick or a critical section. Past TIMING_LATE_LIMIT_US, one
+ *   whole sampler tick and then some, the run fails. On the Artemis, the ticker and the cutoff
+ *   run off the same 3MHz tap and the set points are whole ticks, so they never meet; the AVR's
+ *   9.984ms ticker drifts past every cutoff, so BOARD=generic is the build that catches one
+ *   waiting too long
+ * - notice - from INDUCTOR_PIN going LOW to SOLENOID_PIN going HIGH, which is how long the loop
+ *   took to see the cutoff and move on to DROP_CASE. It's what the lateness would be if the
+ *   loop were still the one switching the inductor off, so it's the number the LCD and sensor
+ *   costs show up in. At the Makefile's default costs, a p99 past TIMING_NOTICE_LIMIT_US fails
+ *   the run too - other costs move it, so it's only reported for those
+ *
+ * The sketch's own lateness histogram (the Data Display menu numbers) is checked against the
+ * pins as well.
+ *
+ **************************************************************************************************/
+
+#include "../../Annealer-Control.h"
+#include "HostSim.h"
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#define TIMING_CYCLES_DEFAULT   2000
+#define TIMING_LATE_LIMIT_US    ((SAMPLER_TICK_CONVERSIONS * SIM_ADC_US) + 20)
+#define TIMING_NOTICE_LIMIT_US  70000   // p99, at these costs - about 61.5ms as of this writing
+#define TIMING_NOTICE_LCD_US    2000
+#define TIMING_NOTICE_POWER_US  300
+#define TIMING_RANGES           4       // report by 5 second slices of the sweep
+
+Menu::result enterAnneal(void);
+
+struct Pulse {
+  unsigned long setMicros;
+  int64_t late;               // negative if the cutoff came early
+  uint64_t notice;
+};
+
+template <typename T> static T percentile(std::vector<T> v, unsigned int pct10) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t rank = (v.size() * pct10 + 999) / 1000;     // nearest rank, pct10 in tenths of a percent
+  return v[rank ? rank - 1 : 0];
+}
+
+template <typename T> static void report(const char *name, const std::vector<T> &v) {
+  printf("  %-8s p50 %8lld  p90 %8lld  p99 %8lld  p99.9 %8lld  max %8lld us\n", name,
+         (long long) percentile(v, 500), (long long) percentile(v, 900),
+         (long long) percentile(v, 990), (long long) percentile(v, 999),
+         (long long) percentile(v, 1000));
+}
+
+int main(int argc, char **argv) {
+  unsigned long cycles = (argc > 1) ? strtoul(argv[1], NULL, 10) : TIMING_CYCLES_DEFAULT;
+  std::vector<Pulse> pulses;
+  Pulse pulse = { 0, 0, 0 };
+  uint64_t inductorOn = 0;
+  uint64_t inductorOff = 0;
+  bool waitDrop = false;
+  unsigned long drops = 0;      // every cycle, including any set point that rounds to no pulse
+
+  simPinWatch = [&](uint8_t pin, uint8_t level) {
+    if (pin == INDUCTOR_PIN) {
+      if (level) {
+        inductorOn = simNow;
+        pulse.setMicros = (unsigned long) floor((annealSetPoint * 1000.0) + 0.5) * 1000UL;   // as armed
+      }
+      else {
+        inductorOff = simNow;
+        pulse.late = (int64_t) (simNow - inductorOn) - (int64_t) pulse.setMicros;
+        waitDrop = true;
+      }
+    }
+    else if ((pin == SOLENOID_PIN) && level) {
+      drops++;
+      if (waitDrop) {
+        pulse.notice = simNow - inductorOff;
+        pulses.push_back(pulse);
+        waitDrop = false;
+      }
+    }
+  };
+
+  simAnalog(THERM1_PIN, simAnalogMax() / 2);
+  simAnalog(CURRENT_PIN, simAnalogMax() / 4);
+  simAnalog(VOLTAGE_PIN, simAnalogMax() / 2);
+
+  simBegin();
+
+  startOnOpto = false;
+  annealSetPoint = TIMING_SWEEP_STEP;
+  caseDropSetPoint = 1.0;
+  delaySetPoint = 0.0;
+  delayGovernor = false;
+  batchSize = 0;
+
+  enterAnneal();
+  simLoopUntil(simNow + 1000000);
+  simPress(START_PIN);
+  while (drops < cycles) simLoop();
+
+  std::vector<int64_t> late, rangeLate[TIMING_RANGES];
+  std::vector<uint64_t> notice, rangeNotice[TIMING_RANGES];
+  uint64_t longest = 0;
+
+  for (size_t i = 0; i < pulses.size(); i++) {
+    unsigned int range = pulses[i].setMicros / (TIMING_SWEEP_MAX * 1000000 / TIMING_RANGES);
+    if (range >= TIMING_RANGES) range = TIMING_RANGES - 1;
+
+    late.push_back(pulses[i].late);
+    notice.push_back(pulses[i].notice);
+    rangeLate[range].push_back(pulses[i].late);
+    rangeNotice[range].push_back(pulses[i].notice);
+    if (pulses[i].setMicros > longest) longest = pulses[i].setMicros;
+  }
+
+  printf("%lu cycles, %lu pulses, set points up to %.2f s, LCD field %u us, power read %u us\n",
+         drops, (unsigned long) pulses.size(), longest / 1e6, (unsigned int) COSTMODEL_LCD_MICROS,
+         (unsigned int) COSTMODEL_POWER_MICROS);
+  printf("all set points\n");
+  report("late", late);
+  report("notice", notice);
+  for (unsigned int r = 0; r < TIMING_RANGES; r++) {
+    printf("%2u-%2u s (%u pulses)\n", r * 5, (r + 1) * 5, (unsigned int) rangeLate[r].size());
+    report("late", rangeLate[r]);
+    report("notice", rangeNotice[r]);
+  }
+  printf("sketch: late p50 %.3f  p99 %.3f  max %.3f ms\n", annealLateP50, annealLateP99,
+         annealLateMax);
+
+  SIM_CHECK(longest > (TIMING_SWEEP_MAX - 1) * 1000000);
+  SIM_CHECK(percentile(late, 0) >= 0);
+  SIM_CHECK(percentile(late, 1000) <= TIMING_LATE_LIMIT_US);
+  if ((COSTMODEL_LCD_MICROS == TIMING_NOTICE_LCD_US) && (COSTMODEL_POWER_MICROS == TIMING_NOTICE_POWER_US)) {
+    SIM_CHECK(percentile(notice, 990) <= TIMING_NOTICE_LIMIT_US);
+  }
+  SIM_CHECK(annealLateness.count == drops);
+  SIM_CHECK((int64_t) annealLateness.maximum == percentile(late, 1000));
+
+  return simReport("TimingBench");
+}
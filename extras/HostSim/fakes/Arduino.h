@@ -0,0 +1,145 @@
+/**************************************************************************************************
+ *
+ * Arduino.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Just enough of the Arduino core for the sketch to build on a PC. Pins, the ADC, the clock, and
+ * interrupts are all backed by the simulated board in HostSim.cpp - see HostSim.h for how a test
+ * drives them. Serial goes to stdout, but only when the simulation asks for it.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            1
+#define LOW             0
+
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEC             10
+#define HEX             16
+
+#define A0              14
+#define A1              15
+#define A2              16
+#define A3              17
+#define A4              18
+#define A5              19
+#define LED_BUILTIN     13
+#define NUM_DIGITAL_PINS 20
+
+#define NOT_AN_INTERRUPT          -1
+#define digitalPinToInterrupt(p)  ((p) < NUM_DIGITAL_PINS ? (int) (p) : NOT_AN_INTERRUPT)
+
+// no separate program memory on a PC
+#define PROGMEM
+#define pgm_read_byte(p)    (*(const uint8_t *) (p))
+#define pgm_read_word(p)    (*(const uint16_t *) (p))
+
+class __FlashStringHelper;
+#define F(s)                ((const __FlashStringHelper *) (s))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReadResolution(int bits);
+#ifdef _AP3_VARIANT_H_
+float getInternalTemp(void);        // the Apollo3 core's
+#endif
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void attachInterrupt(int interrupt, void (*handler)(void), int mode);
+void detachInterrupt(int interrupt);
+void noInterrupts(void);
+void interrupts(void);
+
+
+class String {
+  std::string s;
+
+public:
+  String() {}
+  String(const char *c) : s(c ? c : "") {}
+  String(const __FlashStringHelper *c) : s((const char *) c) {}
+  String(const std::string &c) : s(c) {}
+  String(long n) : s(std::to_string(n)) {}
+
+  unsigned int length(void) const { return s.size(); }
+  const char *c_str(void) const { return s.c_str(); }
+  void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+  long toInt(void) const { return atol(s.c_str()); }
+  void concat(const char *c) { s += c; }
+  void concat(const String &c) { s += c.s; }
+  bool endsWith(const char *c) const {
+    size_t n = strlen(c);
+    return (s.size() >= n) && (s.compare(s.size() - n, n, c) == 0);
+  }
+
+  bool operator==(const char *c) const { return s == c; }
+  bool operator!=(const char *c) const { return s != c; }
+  bool operator==(const String &c) const { return s == c.s; }
+  bool operator<(const String &c) const { return s < c.s; }
+};
+
+
+class Print {
+  size_t printNumber(unsigned long n, uint8_t base);
+
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; }
+
+  size_t print(const __FlashStringHelper *s) { return write((const char *) s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t) c); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long) n, base); }
+  size_t print(int n, int base = DEC) { return print((long) n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+  size_t print(double n, int digits = 2);
+
+  size_t println(void) { return write("\r\n"); }
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void) baud; }
+  operator bool() { return true; }
+  size_t write(uint8_t c);
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif // _HOST_ARDUINO_H
@@ -0,0 +1,54 @@
+/**************************************************************************************************
+ *
+ * Chrono.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * The parts of the Chrono library the sketch uses, in milliseconds, off the simulated clock.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_CHRONO_H
+#define _HOST_CHRONO_H
+
+#include <Arduino.h>
+
+class Chrono {
+  unsigned long startTime;
+  unsigned long offset = 0;
+  bool running;
+
+public:
+  Chrono(bool startNow = true) : running(startNow) { startTime = millis(); }
+
+  void start(unsigned long startOffset = 0) { restart(startOffset); }
+  void restart(unsigned long startOffset = 0) {
+    startTime = millis();
+    offset = startOffset;
+    running = true;
+  }
+  bool stop(void) {
+    if (running) offset = elapsed();
+    bool was = running;
+    running = false;
+    return was;
+  }
+  void resume(void) {
+    if (running) return;
+    startTime = millis();
+    running = true;
+  }
+  void add(unsigned long t) { offset += t; }
+  bool isRunning(void) const { return running; }
+
+  unsigned long elapsed(void) const { return running ? (millis() - startTime + offset) : offset; }
+  bool hasPassed(unsigned long timeout) const { return elapsed() >= timeout; }
+  bool hasPassed(unsigned long timeout, bool restartIfPassed) {
+    if (!hasPassed(timeout)) return false;
+    if (restartIfPassed) restart();
+    return true;
+  }
+};
+
+#endif // _HOST_CHRONO_H
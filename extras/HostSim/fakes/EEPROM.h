@@ -0,0 +1,48 @@
+/**************************************************************************************************
+ *
+ * EEPROM.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Stand-in for the EEPROM library - 1K of bytes in memory, erased (0xFF) at power on, same as a
+ * factory fresh board. get() and put() copy the object's bytes, so the layout matches a 32-bit
+ * board with 4 byte ints, like the Artemis.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_EEPROM_H
+#define _HOST_EEPROM_H
+
+#include <Arduino.h>
+
+#define EEPROM_SIZE     1024
+
+struct EEPROMClass {
+  uint8_t bytes[EEPROM_SIZE];
+  unsigned long writes = 0;         // put()s and write()s that actually changed a byte
+
+  EEPROMClass() { memset(bytes, 0xFF, sizeof(bytes)); }
+
+  uint8_t read(int address) { return bytes[address]; }
+  void write(int address, uint8_t value) {
+    if (bytes[address] != value) writes++;
+    bytes[address] = value;
+  }
+  void update(int address, uint8_t value) { write(address, value); }
+  uint16_t length(void) { return EEPROM_SIZE; }
+
+  template <typename T> T &get(int address, T &t) {
+    memcpy((void *) &t, &bytes[address], sizeof(T));
+    return t;
+  }
+  template <typename T> const T &put(int address, const T &t) {
+    const uint8_t *p = (const uint8_t *) &t;
+    for (size_t i = 0; i < sizeof(T); i++) write(address + i, p[i]);
+    return t;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // _HOST_EEPROM_H
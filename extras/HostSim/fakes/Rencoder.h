@@ -0,0 +1,45 @@
+/**************************************************************************************************
+ *
+ * Rencoder.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Stand-in for the Rencoder library. Nobody's turning the knob - a test does it with
+ * simEncoderTurn() and simEncoderClick() (HostSim.h).
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_RENCODER_H
+#define _HOST_RENCODER_H
+
+#include <Arduino.h>
+
+class Encoder {
+public:
+  int count = 0;
+  int lastCount = 0;
+  bool clicked = false;
+  bool doubleClicked = false;
+
+  Encoder(uint8_t pinA, uint8_t pinB, uint8_t pinButton) { (void) pinA; (void) pinB; (void) pinButton; }
+
+  bool isMoved(void) const { return count != lastCount; }
+  bool isClicked(void) const { return clicked; }
+  bool isDoubleClicked(void) const { return doubleClicked; }
+  int getCount(void) const { return count; }
+  // the movement since last time - the sketch always takes it, flag or no flag
+  int getDiff(bool flag = false) {
+    int diff = count - lastCount;
+    (void) flag;
+    lastCount = count;
+    return diff;
+  }
+  void clear(void) {
+    lastCount = count;
+    clicked = false;
+    doubleClicked = false;
+  }
+};
+
+#endif // _HOST_RENCODER_H
@@ -0,0 +1,56 @@
+/**************************************************************************************************
+ *
+ * SerLCD.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Stand-in for SparkFun's SerLCD library, driving a 20x4 screen held in memory. Every call costs
+ * what it costs on the real thing: the I2C bytes, plus the delays the library waits out after
+ * each transfer - 10ms after text or a command, 50ms after a "special" command like setCursor().
+ * Those delays are most of what an LCD update costs, which is why they're worth simulating.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_SERLCD_H
+#define _HOST_SERLCD_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define SERLCD_COLS           20
+#define SERLCD_ROWS           4
+#define SERLCD_COMMAND_MS     10
+#define SERLCD_SPECIAL_MS     50
+
+class SerLCD : public Print {
+  TwoWire *bus = NULL;
+
+  void transfer(size_t n, unsigned long settleMs);
+
+public:
+  char screen[SERLCD_ROWS][SERLCD_COLS + 1];
+  uint8_t col = 0;
+  uint8_t row = 0;
+  uint8_t red = 0, green = 0, blue = 0;
+
+  unsigned long transfers = 0;      // I2C transactions
+  unsigned long bytes = 0;          // bytes in them
+
+  SerLCD();
+
+  void begin(TwoWire &wire) { bus = &wire; clear(); }
+  void clear(void);
+  void setCursor(uint8_t c, uint8_t r);
+  void setFastBacklight(uint8_t r, uint8_t g, uint8_t b);
+  void noBlink(void) { transfer(2, SERLCD_SPECIAL_MS); }
+  void blink(void) { transfer(2, SERLCD_SPECIAL_MS); }
+  void noCursor(void) { transfer(2, SERLCD_SPECIAL_MS); }
+  void cursor(void) { transfer(2, SERLCD_SPECIAL_MS); }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+};
+
+#endif // _HOST_SERLCD_H
@@ -0,0 +1,49 @@
+/**************************************************************************************************
+ *
+ * SparkFun_Qwiic_OpenLog_Arduino_Library.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Stand-in for SparkFun's Qwiic OpenLog library, with an SD card held in memory - a map of file
+ * name to contents. Writes cost I2C time at the bus speed, plus the OpenLog's own pause after
+ * each write. A test can look at what landed on the card through files, or take the card out
+ * (present = false) before setup() to see how the sketch copes.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_OPENLOG_H
+#define _HOST_OPENLOG_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <map>
+#include <vector>
+
+#define STATUS_SD_INIT_GOOD   0
+#define OPENLOG_WRITE_US      1000    // the OpenLog needs a moment after every write
+
+class OpenLog : public Print {
+  std::string current;                        // file we're appending to
+  std::vector<std::string> listing;           // what searchDirectory() found
+  size_t listed = 0;
+
+public:
+  std::map<std::string, std::string> files;
+  bool present = true;
+
+  bool begin(void) { return present; }
+  uint8_t getStatus(void) { return present ? (1 << STATUS_SD_INIT_GOOD) : 0xFF; }
+
+  bool searchDirectory(const String &pattern);
+  String getNextDirectoryItem(void);
+  bool append(const String &fileName);
+  int32_t size(const String &fileName);
+  bool syncFile(void) { return present; }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+};
+
+#endif // _HOST_OPENLOG_H
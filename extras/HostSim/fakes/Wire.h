@@ -0,0 +1,31 @@
+/**************************************************************************************************
+ *
+ * Wire.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Stand-in for the I2C bus. There's nothing on the other end - the fake SerLCD and OpenLog
+ * charge the simulated clock for their bytes at whatever speed setClock() picked.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_WIRE_H
+#define _HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+  unsigned long clock = 100000;
+
+  void begin(void) {}
+  void setClock(unsigned long hz) { clock = hz; }
+
+  // microseconds on the bus for n bytes - 9 bits each, plus the address byte and start/stop
+  unsigned long transferMicros(size_t n) const { return ((n + 1) * 9 * 1000000UL) / clock + 2; }
+};
+
+extern TwoWire Wire;
+
+#endif // _HOST_WIRE_H
@@ -0,0 +1,2 @@
+// pgm_read_byte() and friends live in the host Arduino.h - there's no program memory to read
+#include <Arduino.h>
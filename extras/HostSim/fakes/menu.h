@@ -0,0 +1,2 @@
+// headless ArduinoMenu - see menuDefs.h
+#include "menuDefs.h"
@@ -0,0 +1,150 @@
+/**************************************************************************************************
+ *
+ * menuDefs.h
+ * Annealer Control Program - host simulation
+ * Author: Dave Re
+ * Inception: 10/15/2026
+ *
+ * Headless stand-in for ArduinoMenu. The simulation never shows the menus - a test goes
+ * straight to annealing or Mayan mode with enterAnneal() or enterMayan(), the same functions the
+ * menu items call. So this only has to be enough for AnnealMenu.h, SerLCDOut.h and RencoderIn.h
+ * to compile: the types they name, and macros that turn each menu into a plain object with
+ * items that can be enabled and disabled. nav.poll() does nothing.
+ *
+ **************************************************************************************************/
+
+#ifndef _HOST_MENU_DEFS_H
+#define _HOST_MENU_DEFS_H
+
+#include <Arduino.h>
+
+#define constMEM                const
+#define MEMMODE
+#define MENU_DEBUG_OUT          Serial
+#define trace(x)
+#define MENU_ITEMS_MAX          32
+
+namespace Menu {
+
+  typedef int8_t idx_t;
+  typedef idx_t Used;
+
+  enum result { proceed = 0, quit = 1 };
+  enum eventMask : int {
+    noEvent = 0, activateEvent = 1, enterEvent = 2, exitEvent = 4, returnEvent = 8,
+    focusEvent = 16, blurEvent = 32, selFocusEvent = 64, selBlurEvent = 128, updateEvent = 256,
+    anyEvent = ~0
+  };
+  enum idleEvent { idleStart, idling, idleEnd };
+  enum styles { noStyle = 0, wrapStyle = 1 };
+  enum systemStyles { _noStyle = 0, _menuData = 1, _canNav = 2, _parentDraw = 4, _asPad = 8 };
+  enum navCmds { noCmd, escCmd, enterCmd, upCmd, downCmd, leftCmd, rightCmd, idxCmd, selCmd };
+
+  struct navCode { navCmds cmd; char ch; };
+  struct config { navCode navCodes[selCmd + 1]; };
+  extern config *options;
+
+  struct navRoot;
+  struct menuNode;
+  struct menuOut;
+
+  struct navNode {
+    navRoot *root = NULL;
+    idx_t sel = 0;
+    menuNode *target = NULL;
+  };
+
+  typedef result (*callback)(eventMask, navNode &);
+  typedef result (*idleFunc)(menuOut &, idleEvent);
+
+  result inaction(menuOut &o, idleEvent e);
+
+  struct prompt {
+    bool enabled = true;
+    void enable(void) { enabled = true; }
+    void disable(void) { enabled = false; }
+  };
+
+  struct menuNodeShadowRaw {
+    callback action;
+    systemStyles sysStyles;
+    const char *text;
+    eventMask events;
+    styles style;
+    idx_t sz;
+    prompt *const *data;
+  };
+  struct menuNodeShadow : menuNodeShadowRaw {};
+
+  struct menuNode : prompt {
+    prompt items[MENU_ITEMS_MAX];
+    prompt &operator[](idx_t i) { return items[i]; }
+  };
+
+  struct menuOut {
+    enum styles { none = 0, redraw = 1, minimalRedraw = 2 };
+    virtual ~menuOut() {}
+    virtual size_t write(uint8_t ch) { (void) ch; return 1; }
+    Used printText(const char *text, idx_t len) { (void) text; return len; }
+  };
+
+  struct panel { idx_t x, y, w, h; };
+  struct panelsList {
+    panel list[1] = { { 0, 0, 20, 4 } };
+    const panel &operator[](idx_t i) const { return list[i]; }
+    void reset(void) {}
+  };
+
+  struct cursorOut : menuOut {
+    panelsList &panels;
+    cursorOut(idx_t *tops, panelsList &p, menuOut::styles s) : panels(p) { (void) tops; (void) s; }
+    virtual void clear(void) {}
+    virtual void setCursor(idx_t x, idx_t y, idx_t panelNr = 0) { (void) x; (void) y; (void) panelNr; }
+    virtual idx_t startCursor(navRoot &root, idx_t x, idx_t y, bool charEdit, idx_t panelNr = 0) = 0;
+    virtual idx_t endCursor(navRoot &root, idx_t x, idx_t y, bool charEdit, idx_t panelNr = 0) = 0;
+    virtual idx_t editCursor(navRoot &root, idx_t x, idx_t y, bool editing, bool charEdit, idx_t panelNr = 0) = 0;
+  };
+
+  struct outputsList {};
+
+  struct menuIn {
+    virtual ~menuIn() {}
+    virtual int available(void) { return 0; }
+    virtual int peek(void) { return -1; }
+    virtual int read(void) { return -1; }
+    virtual void flush(void) {}
+  };
+
+  struct navRoot {
+    navNode path[8];
+    idx_t level = 1;
+    idleFunc sleepTask = NULL;      // set while we're out of the menu system
+    idleFunc idleTask = NULL;
+    int inputBurst = 1;
+    bool useUpdateEvent = false;
+
+    navRoot(menuNode &root, idx_t maxDepth, menuIn &in, outputsList &out) {
+      (void) maxDepth; (void) in; (void) out;
+      for (idx_t i = 0; i < 8; i++) {
+        path[i].root = this;
+        path[i].target = &root;
+      }
+    }
+
+    void poll(void) {}
+    void idleOn(idleFunc task = inaction) { sleepTask = task; }
+    void idleOff(void) { sleepTask = NULL; }
+  };
+
+}
+
+// every menu is just an object - what's in it only matters to a screen
+#define MENU(id, ...)                   Menu::menuNode id
+#define TOGGLE(var, id, ...)            Menu::menuNode id
+#define CHOOSE(var, id, ...)            Menu::menuNode id
+#define SELECT(var, id, ...)            Menu::menuNode id
+#define MENU_OUTPUTS(id, maxDepth, ...) Menu::outputsList id
+#define NAVROOT(id, root, maxDepth, in, out) \
+                                        Menu::navRoot id(root, maxDepth, in, out)
+
+#endif // _HOST_MENU_DEFS_H
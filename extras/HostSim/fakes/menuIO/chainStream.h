@@ -0,0 +1,15 @@
+// headless ArduinoMenu - see menuDefs.h
+#ifndef _HOST_MENU_CHAIN_STREAM_H
+#define _HOST_MENU_CHAIN_STREAM_H
+
+#include "../menuDefs.h"
+
+namespace Menu {
+  template <int N>
+  struct chainStream : menuIn {
+    menuIn **streams;
+    chainStream(menuIn **list) : streams(list) {}
+  };
+}
+
+#endif // _HOST_MENU_CHAIN_STREAM_H
@@ -0,0 +1,13 @@
+// headless ArduinoMenu - see menuDefs.h
+#ifndef _HOST_MENU_SERIAL_IN_H
+#define _HOST_MENU_SERIAL_IN_H
+
+#include "../menuDefs.h"
+
+namespace Menu {
+  struct serialIn : menuIn {
+    serialIn(HardwareSerial &port) { (void) port; }
+  };
+}
+
+#endif // _HOST_MENU_SERIAL_IN_H
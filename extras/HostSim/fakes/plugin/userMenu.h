@@ -0,0 +1,16 @@
+// headless ArduinoMenu - see menuDefs.h
+#ifndef _HOST_MENU_USER_MENU_H
+#define _HOST_MENU_USER_MENU_H
+
+#include "../menuDefs.h"
+
+namespace Menu {
+  struct UserMenu : menuNode {
+    UserMenu(constMEM menuNodeShadow &shadow, menuNode &edit, const char *exitText) {
+      (void) shadow; (void) edit; (void) exitText;
+    }
+    virtual Used printItem(menuOut &out, int idx, int len) = 0;
+  };
+}
+
+#endif // _HOST_MENU_USER_MENU_H